@@ -1,5 +1,29 @@
 #version 450
+// Every block texture is a layer of one array; the material table picks the
+// layer for the block and face carried by the vertex. Layout matches
+// VulkanApp::GpuBlockMaterial.
+layout(constant_id = 0) const int ALPHA_MODE = 0; // 0 opaque, 1 cutout (alpha test), 2 blended
+
+struct BlockMaterial {
+    uint faceLayers[6];
+    uint tint;
+    uint pad;
+};
+layout(set = 0, binding = 2) uniform sampler2DArray blockTextures;
+layout(std430, set = 0, binding = 3) readonly buffer BlockMaterials { BlockMaterial materials[]; };
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragMaterial;
 layout(location = 0) out vec4 outColor;
 void main() {
-    outColor = vec4(0.2, 0.6, 0.9, 1.0);
-}
+    BlockMaterial m = materials[fragMaterial >> 3];
+    float layer = float(m.faceLayers[fragMaterial & 7u]);
+    vec4 albedo = texture(blockTextures, vec3(fragUV, layer)) * unpackUnorm4x8(m.tint);
+    if (ALPHA_MODE == 1 && albedo.a < 0.5) discard;
+
+    // Fixed sun plus ambient, enough to tell the faces of the terrain apart.
+    vec3 sun = normalize(vec3(0.4, 1.0, 0.3));
+    float light = 0.35 + 0.65 * max(dot(normalize(fragNormal), sun), 0.0);
+    outColor = vec4(albedo.rgb * light, ALPHA_MODE == 2 ? albedo.a : 1.0);
+}
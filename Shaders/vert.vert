@@ -1,6 +1,42 @@
 #version 450
+// Chunk meshes are in chunk-local coordinates; each draw supplies its chunk
+// origin, either as a push constant or, for GPU-driven indirect draws, from the
+// chunk table indexed by the instance the culling pass assigned.
+layout(constant_id = 0) const bool INDIRECT_ORIGINS = false;
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+} camera;
+
+struct ChunkDrawInfo {
+    vec4 boundsMin;
+    vec4 boundsMax;
+    vec4 origin;
+    uint indexCount;
+    uint firstIndex;
+    int  vertexOffset;
+    uint pad;
+};
+layout(std430, set = 0, binding = 1) readonly buffer ChunkInfos { ChunkDrawInfo chunks[]; };
+
+layout(push_constant) uniform Draw {
+    vec4 chunkOrigin;
+} draw;
+
 layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in uint inMaterial; // block id << 3 | face
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragMaterial;
+
 void main() {
-    // Simply pass the position through
-    gl_Position = vec4(inPos, 1.0);
+    vec3 origin = INDIRECT_ORIGINS ? chunks[gl_InstanceIndex].origin.xyz : draw.chunkOrigin.xyz;
+    gl_Position = camera.viewProj * vec4(inPos + origin, 1.0);
+    fragNormal = inNormal;
+    fragUV = inUV;
+    fragMaterial = inMaterial;
 }
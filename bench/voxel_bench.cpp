@@ -0,0 +1,646 @@
+// Microbenchmarks for the CPU-side hot paths. Each case is timed over enough
+// iterations to run for at least MIN_SAMPLE_MS, five times over, and reports
+// the median along with heap allocations per operation. Results go to stdout
+// and to a JSON file (voxel_bench.json, or the first argument) for comparing
+// runs.
+#include "Chunk.h"
+#include "Mesher.h"
+#include "PixelGame.h"
+#include "ThreadPool.h"
+#include "World.h"
+#include "Schematic.h"
+#include "StructurePlacer.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Counts every heap allocation in the process, so a benchmark can show that
+// a path allocates nothing.
+static std::atomic<uint64_t> heapAllocations{0};
+
+void* operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr double MIN_SAMPLE_MS = 50.0;
+constexpr int SAMPLES = 5;
+constexpr uint64_t MAX_ITERATIONS = uint64_t(1) << 32;
+
+struct Result {
+    std::string name;
+    double      nsPerOp = 0;
+    uint64_t    iterations = 0; // per sample
+    double      itemsPerOp = 0; // e.g. voxels or vertices, 0 when not meaningful
+    double      allocsPerOp = 0;
+    std::vector<std::pair<std::string, double>> extra; // case-specific figures for the JSON
+};
+
+std::vector<Result> results;
+volatile uint64_t sink; // keeps results of the timed loops alive
+
+// body(n) runs the operation n times. The returned result can take extra figures.
+Result& bench(const std::string& name, const std::function<void(uint64_t)>& body, double itemsPerOp = 0) {
+    uint64_t n = 1;
+    for (;;) {
+        auto t0 = Clock::now();
+        body(n);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        if (ms >= MIN_SAMPLE_MS) break;
+        // A body the compiler managed to delete would never reach the target.
+        if (n >= MAX_ITERATIONS) break;
+        n = ms < 1.0 ? n * 10 : (uint64_t)(n * MIN_SAMPLE_MS / ms * 1.2) + 1;
+    }
+    std::vector<double> samples;
+    samples.reserve(SAMPLES);
+    uint64_t allocsBefore = heapAllocations.load(std::memory_order_relaxed);
+    for (int s = 0; s < SAMPLES; s++) {
+        auto t0 = Clock::now();
+        body(n);
+        samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / double(n));
+    }
+    double allocs = double(heapAllocations.load(std::memory_order_relaxed) - allocsBefore) / double(n * SAMPLES);
+    std::sort(samples.begin(), samples.end());
+    Result r{ name, samples[SAMPLES / 2], n, itemsPerOp, allocs };
+    std::printf("%-40s %14.2f ns/op %10.3f allocs/op  (%llu iterations)\n", name.c_str(), r.nsPerOp,
+                allocs, (unsigned long long)n);
+    results.push_back(r);
+    return results.back();
+}
+
+// Terrain shapes for the mesher, from best to worst case.
+template <class ChunkT>
+void fillFlat(ChunkT& c) {
+    const int ground = ChunkT::GROUND_LEVEL;
+    for (int z = 0; z < ChunkT::SIZE_Z; z++)
+        for (int y = 0; y < ground; y++)
+            for (int x = 0; x < ChunkT::SIZE_X; x++)
+                c.set(x, y, z, { (BlockRegistry::BlockID)(y == ground - 1 ? 2 : 3) });
+}
+
+// Hash-based heightmap: uneven runs, like real terrain.
+template <class ChunkT>
+void fillNoise(ChunkT& c) {
+    for (int z = 0; z < ChunkT::SIZE_Z; z++)
+        for (int x = 0; x < ChunkT::SIZE_X; x++) {
+            uint32_t h = (uint32_t)(x * 374761393u + z * 668265263u);
+            h = (h ^ (h >> 13)) * 1274126177u;
+            int height = 2 + (int)((h >> 16) % (ChunkT::GROUND_LEVEL * 2 - 4));
+            for (int y = 0; y < height; y++)
+                c.set(x, y, z, { (BlockRegistry::BlockID)(y == height - 1 ? 2 : 1) });
+        }
+}
+
+// Alternating solid and air in all three axes: every face exposed, no runs to merge.
+template <class ChunkT>
+void fillCheckerboard(ChunkT& c) {
+    for (int z = 0; z < ChunkT::SIZE_Z; z++)
+        for (int y = 0; y < ChunkT::SIZE_Y; y++)
+            for (int x = 0; x < ChunkT::SIZE_X; x++)
+                c.set(x, y, z, { (BlockRegistry::BlockID)(((x + y + z) & 1) ? 3 : 0) });
+}
+
+void chunkBenchmarks() {
+    Chunk chunk;
+    chunk.generateTestData();
+    const Chunk* volatile input = &chunk; // keeps the loops from being hoisted
+    constexpr int SX = Chunk::SIZE_X, SY = Chunk::SIZE_Y, SZ = Chunk::SIZE_Z;
+    const double voxels = double(Chunk::VOLUME);
+    bench("chunk/get_sequential", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++)
+            for (int z = 0; z < SZ; z++)
+                for (int y = 0; y < SY; y++)
+                    for (int x = 0; x < SX; x++) sum += input->get(x, y, z).type;
+        sink = sum;
+    }, voxels);
+    // Column walks (Y innermost) stride through the array.
+    bench("chunk/get_column_major", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++)
+            for (int x = 0; x < SX; x++)
+                for (int z = 0; z < SZ; z++)
+                    for (int y = 0; y < SY; y++) sum += input->get(x, y, z).type;
+        sink = sum;
+    }, voxels);
+    volatile int zero = 0; // reloaded per pass so the sum can't be folded
+    bench("chunk/index", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            const int j = zero;
+            for (int z = 0; z < SZ; z++)
+                for (int y = 0; y < SY; y++)
+                    for (int x = 0; x < SX; x++) sum += (uint64_t)Chunk::index(x ^ j, y, z);
+        }
+        sink = sum;
+    }, voxels);
+}
+
+void mesherBenchmarks() {
+    struct Shape { const char* name; void (*fill)(Chunk&); };
+    for (Shape shape : { Shape{ "flat", fillFlat<Chunk> }, Shape{ "noise", fillNoise<Chunk> },
+                         Shape{ "test_data", [](Chunk& c) { c.generateTestData(); } },
+                         Shape{ "checkerboard", fillCheckerboard<Chunk> } }) {
+        Chunk chunk;
+        shape.fill(chunk);
+        MeshData probe;
+        greedyMesh(chunk, probe);
+        bench(std::string("mesher/greedy_") + shape.name, [&](uint64_t n) {
+            MeshData mesh;
+            for (uint64_t i = 0; i < n; i++) {
+                mesh.clear();
+                greedyMesh(chunk, mesh);
+            }
+            sink = mesh.vertices.size();
+        }, double(probe.vertices.size()));
+    }
+
+    // Fresh buffers per chunk versus buffers recycled through MeshBufferPool;
+    // the pooled path should report zero allocations per chunk.
+    Chunk chunk;
+    fillNoise(chunk);
+    bench("mesher/fresh_buffers", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            MeshData mesh;
+            MeshScratch scratch;
+            greedyMesh(chunk, mesh, scratch);
+            sink = mesh.vertices.size();
+        }
+    });
+    MeshBufferPool buffers;
+    bench("mesher/pooled_buffers", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            MeshData mesh = buffers.acquire();
+            greedyMesh(chunk, mesh);
+            sink = mesh.vertices.size();
+            buffers.release(std::move(mesh));
+        }
+    });
+}
+
+void threadPoolBenchmarks() {
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    // Throughput: enqueue a batch of empty tasks, then wait for all of them.
+    const uint64_t batch = 1024;
+    bench("threadpool/enqueue_throughput", [&](uint64_t n) {
+        std::vector<std::future<void>> futures;
+        futures.reserve(batch);
+        for (uint64_t i = 0; i < n; i++) {
+            futures.clear();
+            for (uint64_t j = 0; j < batch; j++) futures.push_back(pool.enqueue([] {}));
+            for (auto& f : futures) f.wait();
+        }
+    }, double(batch));
+    // Latency: one task at a time, enqueue to completion.
+    bench("threadpool/round_trip_latency", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) pool.enqueue([] {}).wait();
+    });
+}
+
+void registryBenchmarks() {
+    const BlockView blocks = BlockRegistry::view();
+    std::vector<BlockRegistry::BlockID> ids(4096);
+    for (size_t i = 0; i < ids.size(); i++) ids[i] = (BlockRegistry::BlockID)((i * 2654435761u >> 7) % 7);
+    bench("registry/opaque", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++)
+            for (auto id : ids) sum += blocks.opaque(id);
+        sink = sum;
+    }, double(ids.size()));
+    bench("registry/render_layer", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++)
+            for (auto id : ids) sum += (uint64_t)blocks.renderLayer(id);
+        sink = sum;
+    }, double(ids.size()));
+    bench("registry/face_layer", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++)
+            for (size_t j = 0; j < ids.size(); j++) sum += blocks.faceLayer(ids[j], (int)(j % 6));
+        sink = sum;
+    }, double(ids.size()));
+    bench("registry/view", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++) sum += BlockRegistry::view().tint(2);
+        sink = sum;
+    });
+}
+
+// A bare voxel grid in a given layout, so every layout can be measured in
+// one run; Chunk itself is fixed to the layout picked at compile time. The
+// grid is always 16^3 so that Morton, which needs a cube, can take part.
+constexpr int LAYOUT_GRID_SIZE = 16;
+
+template <class L>
+struct LayoutGrid {
+    using Layout = L;
+    static constexpr int S = LAYOUT_GRID_SIZE;
+    std::array<uint8_t, S * S * S> voxels{};
+    uint8_t get(int x, int y, int z) const { return voxels[Layout::index(x, y, z)]; }
+    void set(int x, int y, int z, uint8_t v) { voxels[Layout::index(x, y, z)] = v; }
+    bool solid(int x, int y, int z) const {
+        return x >= 0 && y >= 0 && z >= 0 && x < S && y < S && z < S && get(x, y, z) != 0;
+    }
+};
+
+// Faces of solid voxels that border air, over all six directions: the
+// neighbour pattern of a full mesher or an AO pass.
+template <class Grid>
+uint64_t countExposedFaces(const Grid& g) {
+    const int S = Grid::S;
+    uint64_t faces = 0;
+    for (int z = 0; z < S; z++)
+        for (int y = 0; y < S; y++)
+            for (int x = 0; x < S; x++) {
+                if (!g.get(x, y, z)) continue;
+                faces += !g.solid(x - 1, y, z) + !g.solid(x + 1, y, z) +
+                         !g.solid(x, y - 1, z) + !g.solid(x, y + 1, z) +
+                         !g.solid(x, y, z - 1) + !g.solid(x, y, z + 1);
+            }
+    return faces;
+}
+
+// Sky light flood fill: level 15 enters every air voxel of the top layer and
+// spreads through air, losing one level per step. The light array shares the
+// grid's layout.
+template <class Grid>
+uint64_t propagateLight(const Grid& g, std::array<uint8_t, Grid::S * Grid::S * Grid::S>& light,
+                        std::vector<std::array<int8_t, 3>>& queue) {
+    const int S = Grid::S;
+    light.fill(0);
+    queue.clear();
+    for (int z = 0; z < S; z++)
+        for (int x = 0; x < S; x++)
+            if (!g.get(x, S - 1, z)) {
+                light[Grid::Layout::index(x, S - 1, z)] = 15;
+                queue.push_back({ (int8_t)x, (int8_t)(S - 1), (int8_t)z });
+            }
+    static const int dirs[6][3] = { {1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1} };
+    for (size_t head = 0; head < queue.size(); head++) {
+        auto [x, y, z] = queue[head];
+        uint8_t level = light[Grid::Layout::index(x, y, z)];
+        if (level <= 1) continue;
+        for (auto& d : dirs) {
+            int nx = x + d[0], ny = y + d[1], nz = z + d[2];
+            if (nx < 0 || ny < 0 || nz < 0 || nx >= S || ny >= S || nz >= S || g.get(nx, ny, nz)) continue;
+            uint8_t& l = light[Grid::Layout::index(nx, ny, nz)];
+            if (l >= level - 1) continue;
+            l = level - 1;
+            queue.push_back({ (int8_t)nx, (int8_t)ny, (int8_t)nz });
+        }
+    }
+    return queue.size();
+}
+
+// Amanatides-Woo voxel traversal until the ray hits a solid voxel or leaves.
+template <class Grid>
+int raycast(const Grid& g, glm::vec3 origin, glm::vec3 dir) {
+    const int S = Grid::S;
+    int x = (int)origin.x, y = (int)origin.y, z = (int)origin.z;
+    int step[3] = { dir.x < 0 ? -1 : 1, dir.y < 0 ? -1 : 1, dir.z < 0 ? -1 : 1 };
+    float o[3] = { origin.x, origin.y, origin.z };
+    float d[3] = { dir.x, dir.y, dir.z };
+    int p[3] = { x, y, z };
+    float tMax[3], tDelta[3];
+    for (int a = 0; a < 3; a++) {
+        tDelta[a] = d[a] != 0.f ? std::abs(1.f / d[a]) : 1e30f;
+        float edge = step[a] > 0 ? float(p[a] + 1) - o[a] : o[a] - float(p[a]);
+        tMax[a] = d[a] != 0.f ? edge * tDelta[a] : 1e30f;
+    }
+    for (int steps = 0; steps < 3 * S; steps++) {
+        if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= S || p[1] >= S || p[2] >= S) return -1;
+        if (g.get(p[0], p[1], p[2])) return steps;
+        int a = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+        p[a] += step[a];
+        tMax[a] += tDelta[a];
+    }
+    return -1;
+}
+
+template <class Layout>
+void layoutBenchmarks() {
+    using Grid = LayoutGrid<Layout>;
+    const std::string prefix = std::string("layout/") + Layout::NAME + "/";
+    BasicChunk<Grid::S, Grid::S, Grid::S> source;
+    fillNoise(source);
+    Grid grid;
+    for (int z = 0; z < Grid::S; z++)
+        for (int y = 0; y < Grid::S; y++)
+            for (int x = 0; x < Grid::S; x++) grid.set(x, y, z, source.get(x, y, z).type);
+
+    // Read through a volatile pointer so the kernels aren't hoisted out of the loops.
+    const Grid* volatile input = &grid;
+    bench(prefix + "exposed_faces", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++) sum += countExposedFaces(*input);
+        sink = sum;
+    });
+    std::array<uint8_t, Grid::S * Grid::S * Grid::S> light;
+    std::vector<std::array<int8_t, 3>> queue;
+    queue.reserve(Grid::S * Grid::S * Grid::S * 6);
+    bench(prefix + "light_bfs", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++) sum += propagateLight(*input, light, queue);
+        sink = sum;
+    });
+    // Fixed pseudo-random rays from above the terrain, so every layout casts the same ones.
+    std::vector<std::pair<glm::vec3, glm::vec3>> rays;
+    uint32_t seed = 12345;
+    auto rnd = [&seed] { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1u << 24); };
+    for (int i = 0; i < 256; i++) {
+        glm::vec3 origin(rnd() * Grid::S, Grid::S - 0.5f, rnd() * Grid::S);
+        glm::vec3 dir(rnd() * 2.f - 1.f, -0.2f - rnd(), rnd() * 2.f - 1.f);
+        rays.push_back({ origin, dir });
+    }
+    bench(prefix + "raycast", [&](uint64_t n) {
+        int64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++)
+            for (auto& r : rays) sum += raycast(*input, r.first, r.second);
+        sink = (uint64_t)sum;
+    }, double(rays.size()));
+}
+
+// Chunk bulk operations against the per-voxel loops they replace, then the
+// world-level ones over a 512x64x512 region (16.7M voxels).
+void bulkBenchmarks() {
+    auto chunk = std::make_unique<Chunk>();
+    chunk->generateTestData();
+    Chunk* volatile target = chunk.get();
+    const glm::ivec3 dims = Chunk::dims();
+    const double voxels = double(Chunk::VOLUME);
+    bench("bulk/chunk/fill_box_per_voxel", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++)
+            for (int z = 0; z < dims.z; z++)
+                for (int y = 0; y < dims.y; y++)
+                    for (int x = 0; x < dims.x; x++) target->set(x, y, z, { (BlockRegistry::BlockID)(i & 3) });
+    }, voxels);
+    bench("bulk/chunk/fill_box", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) target->fillBox(glm::ivec3(0), dims, { (BlockRegistry::BlockID)(i & 3) });
+    }, voxels);
+    // An odd-sized box inside the chunk: row at a time rather than whole layers.
+    const glm::ivec3 lo(1, 1, 1), hi = dims - glm::ivec3(2);
+    const double inner = double((hi.x - lo.x) * (hi.y - lo.y) * (hi.z - lo.z));
+    bench("bulk/chunk/fill_box_inner", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) target->fillBox(lo, hi, { (BlockRegistry::BlockID)(i & 3) });
+    }, inner);
+    bench("bulk/chunk/fill_sphere", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++)
+            target->fillSphere(glm::vec3(dims) * 0.5f, float(dims.x) * 0.4f, { (BlockRegistry::BlockID)(i & 3) });
+    });
+    chunk->generateTestData();
+    bench("bulk/chunk/count_per_voxel", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++)
+            for (int z = 0; z < dims.z; z++)
+                for (int y = 0; y < dims.y; y++)
+                    for (int x = 0; x < dims.x; x++) sum += target->get(x, y, z).type == 1;
+        sink = sum;
+    }, voxels);
+    bench("bulk/chunk/count", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++) sum += target->count(glm::ivec3(0), dims, { 1 });
+        sink = sum;
+    }, voxels);
+    bench("bulk/chunk/replace", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++)
+            target->replace(glm::ivec3(0), dims, { (BlockRegistry::BlockID)(i & 1) }, { (BlockRegistry::BlockID)(~i & 1) });
+    }, voxels);
+    auto other = std::make_unique<Chunk>();
+    bench("bulk/chunk/copy_region", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) other->copyRegion(*target, lo, lo + glm::ivec3(1), hi - lo);
+        sink = other->get(2, 2, 2).type;
+    }, inner);
+
+    const glm::ivec3 worldVoxels(512, 64, 512);
+    const glm::ivec3 worldChunks = worldVoxels / dims;
+    ChunkPool pool;
+    World world(pool);
+    for (int z = 0; z < worldChunks.z; z++)
+        for (int y = 0; y < worldChunks.y; y++)
+            for (int x = 0; x < worldChunks.x; x++) {
+                ChunkHandle handle = pool.acquire();
+                pool.get(handle)->position = { x, y, z };
+                world.insert(handle);
+            }
+    const double worldVolume = double(worldVoxels.x) * worldVoxels.y * worldVoxels.z;
+    bench("bulk/world/fill_box", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) world.fillBox(glm::ivec3(0), worldVoxels, { (BlockRegistry::BlockID)(i & 3) });
+    }, worldVolume);
+    bench("bulk/world/count", [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; i++) sum += world.count(glm::ivec3(0), worldVoxels, { 1 });
+        sink = sum;
+    }, worldVolume);
+    bench("bulk/world/replace", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++)
+            world.replace(glm::ivec3(0), worldVoxels, { (BlockRegistry::BlockID)(i & 3) }, { (BlockRegistry::BlockID)((i + 1) & 3) });
+    }, worldVolume);
+    bench("bulk/world/fill_sphere", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++)
+            world.fillSphere(glm::vec3(256.f, 32.f, 256.f), 60.f, { (BlockRegistry::BlockID)(i & 3) });
+    });
+    const glm::ivec3 copySize(128, 32, 128);
+    bench("bulk/world/copy_region", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) world.copyRegion(glm::ivec3(3, 5, 7), glm::ivec3(3, 5, 7) + copySize, glm::ivec3(200, 20, 190));
+    }, double(copySize.x) * copySize.y * copySize.z);
+}
+
+// Stamping 4096 bushes into a generated 512x512-voxel world, with the pool at
+// one worker and at one per core, plus the schematic codec.
+void structureBenchmarks() {
+    const glm::ivec3 worldChunks = glm::ivec3(512, Chunk::SIZE_Y, 512) / Chunk::dims();
+    ChunkPool chunkPool;
+    World world(chunkPool);
+    std::vector<Chunk*> loaded;
+    for (int z = 0; z < worldChunks.z; z++)
+        for (int x = 0; x < worldChunks.x; x++) {
+            ChunkHandle handle = chunkPool.acquire();
+            Chunk* chunk = chunkPool.get(handle);
+            chunk->position = { x, 0, z };
+            chunk->generateTestData();
+            world.insert(handle);
+            loaded.push_back(chunk);
+        }
+    auto bush = std::make_shared<const Schematic>(Schematic::bush(3));
+    std::vector<glm::ivec3> origins;
+    uint32_t seed = 99;
+    for (int i = 0; i < 4096; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        origins.push_back({ int(seed >> 8) % 505, Chunk::GROUND_LEVEL, int(seed >> 20) % 505 });
+    }
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads : { 1u, cores }) {
+        if (threads == cores && cores == 1) break;
+        ThreadPool pool(threads);
+        StructurePlacer placer(world, pool);
+        for (Chunk* chunk : loaded) placer.chunkGenerated(*chunk);
+        bench("structures/place_flush_" + std::to_string(threads) + "_threads", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                for (const glm::ivec3& origin : origins) placer.place(bush, origin);
+                sink = placer.flush().size();
+            }
+        }, double(origins.size()));
+    }
+
+    const Schematic boulder = Schematic::boulder(15);
+    const std::vector<uint8_t> encoded = boulder.encode();
+    bench("structures/encode_boulder31", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) sink = boulder.encode().size();
+    }, double(boulder.size().x * boulder.size().y * boulder.size().z));
+    bench("structures/decode_boulder31", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) sink = Schematic::decode(encoded).size().x;
+    }, double(boulder.size().x * boulder.size().y * boulder.size().z)).extra = {
+        { "encoded_bytes", double(encoded.size()) } };
+}
+
+// Not timed: the codec has to round-trip, and reject a truncated file and a
+// header claiming a volume its runs can't cover (4096^3 from one run) with
+// std::runtime_error rather than by trying to allocate it.
+bool checkSchematicCodec() {
+    const Schematic boulder = Schematic::boulder(15);
+    const Schematic decoded = Schematic::decode(boulder.encode());
+    const glm::ivec3 size = boulder.size();
+    if (decoded.size() != size) return false;
+    for (int z = 0; z < size.z; z++)
+        for (int y = 0; y < size.y; y++)
+            for (int x = 0; x < size.x; x++)
+                if (decoded.get(x, y, z) != boulder.get(x, y, z)) return false;
+
+    auto rejected = [](const std::vector<uint8_t>& bytes) {
+        try {
+            Schematic::decode(bytes);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    std::vector<uint8_t> truncated = boulder.encode();
+    truncated.pop_back();
+    std::vector<uint8_t> oversized = Schematic(glm::ivec3(1)).encode(); // header, one entry, one run
+    for (size_t axis = 0; axis < 3; axis++) {  // sizeX..sizeZ follow magic and version, little-endian
+        oversized[8 + 2 * axis] = 0x00;
+        oversized[9 + 2 * axis] = 0x10;        // 4096
+    }
+    std::vector<uint8_t> unknown = Schematic(glm::ivec3(1)).encode();
+    unknown[21] = 'B';                         // palette entry "Air" becomes "Bir"
+    return rejected(truncated) && rejected(oversized) && rejected(unknown);
+}
+
+// The same 256x256-voxel footprint of test terrain cut into chunks of a given
+// shape, one chunk high as PixelGame loads it: meshing all of it, remeshing
+// one chunk after an edit, and the draw calls and memory the result takes.
+constexpr int DIMS_FOOTPRINT = 256;
+
+template <class ChunkT>
+void dimsBenchmarks() {
+    const glm::ivec3 d = ChunkT::dims();
+    const std::string prefix = "dims/" + std::to_string(d.x) + "x" + std::to_string(d.y) + "x" +
+                               std::to_string(d.z) + "/";
+    std::vector<std::unique_ptr<ChunkT>> chunks; // a 32x256x32 chunk is too big for the stack
+    for (int z = 0; z < DIMS_FOOTPRINT / d.z; z++)
+        for (int x = 0; x < DIMS_FOOTPRINT / d.x; x++) {
+            chunks.push_back(std::make_unique<ChunkT>());
+            chunks.back()->position = { x, 0, z };
+            chunks.back()->generateTestData();
+        }
+
+    std::vector<MeshData> meshes(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) greedyMesh(*chunks[i], meshes[i]);
+    double draws = 0, meshBytes = 0, vertices = 0;
+    for (const MeshData& mesh : meshes) {
+        if (!mesh.indices.empty()) draws++;
+        vertices += double(mesh.vertices.size());
+        meshBytes += double(mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(uint32_t));
+    }
+    const double chunkBytes = double(chunks.size() * sizeof(ChunkT));
+
+    bench(prefix + "mesh_world", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++)
+            for (size_t c = 0; c < chunks.size(); c++) {
+                meshes[c].clear();
+                greedyMesh(*chunks[c], meshes[c]);
+            }
+        sink = meshes[0].vertices.size();
+    }, vertices).extra = { { "chunks", double(chunks.size()) }, { "draw_calls", draws },
+                           { "chunk_bytes", chunkBytes }, { "mesh_bytes", meshBytes } };
+    bench(prefix + "remesh_chunk", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            meshes[0].clear();
+            greedyMesh(*chunks[0], meshes[0]);
+        }
+        sink = meshes[0].vertices.size();
+    }, double(ChunkT::VOLUME));
+    std::printf("%-40s %8.0f chunks %8.0f draws %10.1f KiB voxels %10.1f KiB meshes\n", prefix.c_str(),
+                double(chunks.size()), draws, chunkBytes / 1024.0, meshBytes / 1024.0);
+}
+
+bool writeResults(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+    const glm::ivec3 dims = Chunk::dims();
+    out << "{\n  \"chunk_layout\": \"" << Chunk::Layout::NAME << "\",\n  \"chunk_dims\": [" << dims.x
+        << ", " << dims.y << ", " << dims.z << "],\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out << "    { \"name\": \"" << r.name << "\", \"ns_per_op\": " << r.nsPerOp
+            << ", \"iterations\": " << r.iterations << ", \"items_per_op\": " << r.itemsPerOp
+            << ", \"allocs_per_op\": " << r.allocsPerOp;
+        for (const auto& e : r.extra) out << ", \"" << e.first << "\": " << e.second;
+        out << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "voxel_bench.json";
+    PixelGame::registerBlocks();
+    if (!checkSchematicCodec()) {
+        std::cerr << "ERROR: Schematic codec check failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Chunk layout: " << Chunk::Layout::NAME << ", dimensions: " << Chunk::SIZE_X << "x"
+              << Chunk::SIZE_Y << "x" << Chunk::SIZE_Z << "\n";
+    chunkBenchmarks();
+    mesherBenchmarks();
+    threadPoolBenchmarks();
+    registryBenchmarks();
+    constexpr int G = LAYOUT_GRID_SIZE;
+    layoutBenchmarks<LinearLayout<G, G, G>>();
+    layoutBenchmarks<MortonLayout<G, G, G>>();
+    layoutBenchmarks<BrickedLayout<G, G, G>>();
+    bulkBenchmarks();
+    structureBenchmarks();
+    dimsBenchmarks<BasicChunk<16, 16, 16>>();
+    dimsBenchmarks<BasicChunk<32, 32, 32>>();
+#if VOXEL_CHUNK_LAYOUT != 1 // Morton needs cubic chunks
+    dimsBenchmarks<BasicChunk<32, 256, 32>>();
+#endif
+    if (!writeResults(path)) {
+        std::cerr << "ERROR: Failed to write " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Results written to " << path << "\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+CameraKeyframe CameraPath::sample(float t) const {
+    if (keys.empty()) return CameraKeyframe{};
+    if (keys.size() == 1) return keys[0];
+    float pos = std::min(std::max(t, 0.f), 1.f) * float(keys.size() - 1);
+    size_t i = std::min((size_t)pos, keys.size() - 2);
+    float f = pos - float(i);
+    const CameraKeyframe& a = keys[i];
+    const CameraKeyframe& b = keys[i + 1];
+    CameraKeyframe out;
+    out.position = a.position + (b.position - a.position) * f;
+    out.yaw = a.yaw + (b.yaw - a.yaw) * f;
+    out.pitch = a.pitch + (b.pitch - a.pitch) * f;
+    return out;
+}
+
+CameraPath CameraPath::flyover(float worldExtent) {
+    const float e = worldExtent * 0.8f;
+    CameraPath path;
+    path.add({ glm::vec3(-e, 48.f, -e),  45.f, -30.f });
+    path.add({ glm::vec3(0.f, 20.f, 0.f), 45.f, -10.f });
+    path.add({ glm::vec3(e, 18.f, e),    135.f, -5.f });
+    path.add({ glm::vec3(e, 40.f, -e),   225.f, -20.f });
+    path.add({ glm::vec3(0.f, 96.f, 0.f), 270.f, -80.f });
+    return path;
+}
+
+struct FrameSummary {
+    double meanCpu = 0, p50 = 0, p95 = 0, p99 = 0;
+    double meanGpu = -1;
+};
+
+static FrameSummary summarize(const std::vector<FrameStats>& frames) {
+    FrameSummary s;
+    if (frames.empty()) return s;
+    std::vector<double> cpu;
+    cpu.reserve(frames.size());
+    double gpuTotal = 0;
+    size_t gpuCount = 0;
+    for (const FrameStats& f : frames) {
+        cpu.push_back(f.cpuMs);
+        s.meanCpu += f.cpuMs;
+        if (f.gpu.totalMs >= 0) { gpuTotal += f.gpu.totalMs; gpuCount++; }
+    }
+    s.meanCpu /= double(frames.size());
+    std::sort(cpu.begin(), cpu.end());
+    auto pct = [&](double p) { return cpu[std::min(cpu.size() - 1, (size_t)(p * cpu.size()))]; };
+    s.p50 = pct(0.50);
+    s.p95 = pct(0.95);
+    s.p99 = pct(0.99);
+    if (gpuCount) s.meanGpu = gpuTotal / double(gpuCount);
+    return s;
+}
+
+static bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c >= 0x20) out += c;
+    }
+    return out;
+}
+
+void writeBenchmarkReport(const BenchmarkOptions& options, const std::string& deviceName,
+                          const std::vector<FrameStats>& frames) {
+    std::ofstream out(options.reportPath);
+    if (!out) throw std::runtime_error("Failed to open benchmark report " + options.reportPath);
+    FrameSummary s = summarize(frames);
+
+    if (endsWith(options.reportPath, ".json")) {
+        out << "{\n  \"device\": \"" << jsonEscape(deviceName) << "\",\n"
+            << "  \"width\": " << options.width << ",\n"
+            << "  \"height\": " << options.height << ",\n"
+            << "  \"summary\": { \"frames\": " << frames.size()
+            << ", \"cpu_ms_mean\": " << s.meanCpu << ", \"cpu_ms_p50\": " << s.p50
+            << ", \"cpu_ms_p95\": " << s.p95 << ", \"cpu_ms_p99\": " << s.p99
+            << ", \"gpu_ms_mean\": " << s.meanGpu << " },\n"
+            << "  \"frames\": [\n";
+        for (size_t i = 0; i < frames.size(); i++) {
+            const FrameStats& f = frames[i];
+            out << "    { \"frame\": " << f.frame << ", \"cpu_ms\": " << f.cpuMs
+                << ", \"gpu_ms\": " << f.gpu.totalMs << ", \"draw_calls\": " << f.drawCalls
+                << ", \"triangles\": " << f.triangles << ", \"gpu_passes\": {";
+            for (size_t p = 0; p < f.gpu.passes.size(); p++)
+                out << (p ? ", \"" : " \"") << jsonEscape(f.gpu.passes[p].name) << "\": " << f.gpu.passes[p].ms;
+            out << (f.gpu.passes.empty() ? "}" : " }");
+            if (f.gpu.hasStatistics)
+                out << ", \"vertex_invocations\": " << f.gpu.vertexInvocations
+                    << ", \"clipping_invocations\": " << f.gpu.clippingInvocations
+                    << ", \"clipping_primitives\": " << f.gpu.clippingPrimitives
+                    << ", \"fragment_invocations\": " << f.gpu.fragmentInvocations;
+            out << " }" << (i + 1 < frames.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        return;
+    }
+
+    // CSV: summary as comment lines so the table still loads as-is.
+    out << "# device: " << deviceName << "\n"
+        << "# resolution: " << options.width << "x" << options.height << "\n"
+        << "# " << summarizeBenchmark(frames) << "\n"
+        << "frame,cpu_ms,gpu_ms,draw_calls,triangles,vertex_invocations,"
+           "clipping_invocations,clipping_primitives,fragment_invocations\n";
+    // Pipeline statistics are left empty when the device can't provide them.
+    for (const FrameStats& f : frames) {
+        out << f.frame << ',' << f.cpuMs << ',' << f.gpu.totalMs << ','
+            << f.drawCalls << ',' << f.triangles;
+        if (f.gpu.hasStatistics)
+            out << ',' << f.gpu.vertexInvocations << ',' << f.gpu.clippingInvocations
+                << ',' << f.gpu.clippingPrimitives << ',' << f.gpu.fragmentInvocations << '\n';
+        else
+            out << ",,,,\n";
+    }
+}
+
+std::string summarizeBenchmark(const std::vector<FrameStats>& frames) {
+    FrameSummary s = summarize(frames);
+    std::ostringstream ss;
+    ss << frames.size() << " frames, cpu ms mean " << s.meanCpu << " p50 " << s.p50
+       << " p95 " << s.p95 << " p99 " << s.p99 << ", gpu ms mean ";
+    if (s.meanGpu >= 0) ss << s.meanGpu;
+    else ss << "n/a";
+    return ss.str();
+}
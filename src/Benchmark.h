@@ -0,0 +1,45 @@
+#pragma once
+#include "VulkanApp.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// One point on a scripted camera path, in the same terms as PlayerController.
+struct CameraKeyframe {
+    glm::vec3 position{0.f};
+    float     yaw = 0.f;   // degrees
+    float     pitch = 0.f; // degrees
+};
+
+// Piecewise-linear camera path sampled by normalised time, so a run of N
+// frames always covers the whole path regardless of frame rate.
+class CameraPath {
+public:
+    void add(const CameraKeyframe& key) { keys.push_back(key); }
+    // t in [0, 1]; clamps outside it.
+    CameraKeyframe sample(float t) const;
+    bool empty() const { return keys.empty(); }
+
+    // A flyover of the generated world that crosses it at terrain height,
+    // dips into the ponds and ends looking back down over it.
+    static CameraPath flyover(float worldExtent);
+
+private:
+    std::vector<CameraKeyframe> keys;
+};
+
+struct BenchmarkOptions {
+    std::string reportPath;          // .json writes JSON, anything else CSV
+    uint32_t    frames = 600;
+    uint32_t    warmupFrames = 60;   // rendered but not recorded
+    uint32_t    width = 1280;
+    uint32_t    height = 720;
+};
+
+// Writes the per-frame samples plus a summary header (device, resolution,
+// mean/p50/p95/p99 CPU ms, mean GPU ms). JSON also carries per-pass GPU
+// times. Throws when the file can't be opened.
+void writeBenchmarkReport(const BenchmarkOptions& options, const std::string& deviceName,
+                          const std::vector<FrameStats>& frames);
+// One-line summary for the console.
+std::string summarizeBenchmark(const std::vector<FrameStats>& frames);
@@ -1,17 +1,58 @@
 #include "BlockRegistry.h"
+#include <stdexcept>
 
-std::vector<BlockType> BlockRegistry::blocks;
+BlockTables BlockRegistry::tables;
+std::vector<std::string> BlockRegistry::names;
+std::vector<std::string> BlockRegistry::textureNames = { "missing" };
+bool BlockRegistry::isFrozen = false;
 
-BlockRegistry::BlockID BlockRegistry::registerBlock(const std::string& name, bool opaque) {
-    BlockID id = static_cast<BlockID>(blocks.size());
-    blocks.push_back({name, opaque});
+BlockRegistry::BlockID BlockRegistry::registerBlock(const BlockDesc& desc) {
+    if (isFrozen)
+        throw std::runtime_error("Failed to register block " + desc.name + ": registry is frozen");
+    if (names.size() >= BlockTables::MAX_BLOCKS)
+        throw std::runtime_error("Failed to register block " + desc.name + ": too many blocks");
+    BlockID id = static_cast<BlockID>(names.size());
+    names.push_back(desc.name);
+    if (desc.opaque) tables.opaque[id >> 6] |= 1ull << (id & 63);
+    tables.transparency[id] = desc.transparency;
+    tables.emission[id] = desc.emission;
+    tables.collision[id] = desc.collision;
+    tables.renderLayer[id] = desc.renderLayer;
+    for (size_t face = 0; face < desc.textures.size(); ++face)
+        tables.faceLayers[id][face] = textureLayer(desc.textures[face]);
+    tables.tint[id] = desc.tint;
     return id;
 }
 
-const BlockType& BlockRegistry::get(BlockID id) {
-    return blocks.at(id);
+bool BlockRegistry::find(const std::string& name, BlockID& id) {
+    for (size_t i = 0; i < names.size(); ++i)
+        if (names[i] == name) {
+            id = static_cast<BlockID>(i);
+            return true;
+        }
+    return false;
 }
 
-size_t BlockRegistry::count() {
-    return blocks.size();
+BlockView BlockRegistry::view() {
+    if (!isFrozen)
+        throw std::runtime_error("BlockRegistry read before freeze()");
+    return BlockView(tables);
+}
+
+BlockFaceTextures BlockRegistry::allFaces(const std::string& texture) {
+    return { texture, texture, texture, texture, texture, texture };
+}
+
+BlockFaceTextures BlockRegistry::columnFaces(const std::string& top, const std::string& side,
+                                             const std::string& bottom) {
+    return { side, side, bottom, top, side, side };
+}
+
+// Blocks sharing a texture share its layer.
+uint16_t BlockRegistry::textureLayer(const std::string& name) {
+    if (name.empty()) return 0;
+    for (size_t i = 0; i < textureNames.size(); ++i)
+        if (textureNames[i] == name) return static_cast<uint16_t>(i);
+    textureNames.push_back(name);
+    return static_cast<uint16_t>(textureNames.size() - 1);
 }
@@ -1,19 +1,86 @@
 #pragma once
+#include <array>
 #include <string>
 #include <vector>
 #include <cstdint>
 
-struct BlockType {
-    std::string name;
-    bool opaque;
+// Texture names per face in ChunkFace order (-X, +X, -Y, +Y, -Z, +Z). Empty
+// names fall back to the "missing" texture.
+using BlockFaceTextures = std::array<std::string, 6>;
+
+enum class CollisionShape : uint8_t { None, Full };
+enum class RenderLayer : uint8_t { Opaque, Cutout, Translucent };
+
+// Everything registerBlock() needs to know about a block type.
+struct BlockDesc {
+    std::string       name;
+    bool              opaque = true;        // hides the faces of its neighbours
+    uint8_t           transparency = 0;     // 0 blocks light and sight, 255 lets all through
+    uint8_t           emission = 0;         // light level 0-15
+    CollisionShape    collision = CollisionShape::Full;
+    RenderLayer       renderLayer = RenderLayer::Opaque;
+    BlockFaceTextures textures{};
+    uint32_t          tint = 0xFFFFFFFF;    // RGBA8 (R in the low byte), multiplies the texture
 };
 
-class BlockRegistry {
+// Block properties as one flat table per property, indexed by block id. A
+// BlockID is a uint8_t, so every table covers all 256 ids and lookups need
+// no bounds checks.
+struct BlockTables {
+    static constexpr size_t MAX_BLOCKS = 256;
+    std::array<uint64_t, MAX_BLOCKS / 64>              opaque{}; // bitset
+    std::array<uint8_t, MAX_BLOCKS>                    transparency{};
+    std::array<uint8_t, MAX_BLOCKS>                    emission{};
+    std::array<CollisionShape, MAX_BLOCKS>             collision{};
+    std::array<RenderLayer, MAX_BLOCKS>                renderLayer{};
+    std::array<std::array<uint16_t, 6>, MAX_BLOCKS>    faceLayers{}; // block texture array layer per face
+    std::array<uint32_t, MAX_BLOCKS>                   tint{};
+};
+
+// Cheap, copyable read access to the property tables for hot loops. Take one
+// per job rather than going through BlockRegistry per voxel.
+class BlockView {
 public:
     using BlockID = uint8_t;
-    static BlockID registerBlock(const std::string& name, bool opaque);
-    static const BlockType& get(BlockID id);
-    static size_t count();
+    constexpr explicit BlockView(const BlockTables& tables) : t(&tables) {}
+
+    constexpr bool opaque(BlockID id) const { return (t->opaque[id >> 6] >> (id & 63)) & 1; }
+    constexpr uint8_t transparency(BlockID id) const { return t->transparency[id]; }
+    constexpr uint8_t emission(BlockID id) const { return t->emission[id]; }
+    constexpr CollisionShape collision(BlockID id) const { return t->collision[id]; }
+    constexpr RenderLayer renderLayer(BlockID id) const { return t->renderLayer[id]; }
+    constexpr uint16_t faceLayer(BlockID id, int face) const { return t->faceLayers[id][face]; }
+    constexpr uint32_t tint(BlockID id) const { return t->tint[id]; }
+
+private:
+    const BlockTables* t;
+};
+
+// Blocks are registered during startup and the registry is then frozen.
+// From then on the tables never change, so any thread may read them without
+// locking. Names live on a separate cold table.
+class BlockRegistry {
+public:
+    using BlockID = BlockView::BlockID;
+    static BlockID registerBlock(const BlockDesc& desc);
+    static void freeze() { isFrozen = true; }
+    static bool frozen() { return isFrozen; }
+    // Throws until the registry is frozen.
+    static BlockView view();
+    static const std::string& name(BlockID id) { return names[id]; }
+    // Looks a block up by name; false when none has it.
+    static bool find(const std::string& name, BlockID& id);
+    static size_t count() { return names.size(); }
+
+    static BlockFaceTextures allFaces(const std::string& texture);
+    static BlockFaceTextures columnFaces(const std::string& top, const std::string& side,
+                                         const std::string& bottom);
+    // Texture names by array layer. Layer 0 is always "missing".
+    static const std::vector<std::string>& textures() { return textureNames; }
 private:
-    static std::vector<BlockType> blocks;
+    static BlockTables tables;
+    static std::vector<std::string> names;
+    static std::vector<std::string> textureNames;
+    static bool isFrozen;
+    static uint16_t textureLayer(const std::string& name);
 };
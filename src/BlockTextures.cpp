@@ -0,0 +1,52 @@
+#include "BlockTextures.h"
+#include <algorithm>
+
+static uint32_t hash(uint32_t x, uint32_t y, uint32_t seed) {
+    uint32_t h = x * 374761393u + y * 668265263u + seed * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return h ^ (h >> 16);
+}
+
+static uint32_t rgba(int r, int g, int b, int a = 255) {
+    auto c = [](int v) { return (uint32_t)std::clamp(v, 0, 255); };
+    return c(r) | c(g) << 8 | c(b) << 16 | c(a) << 24;
+}
+
+// Base colour with a per-texel brightness jitter of +-amount.
+static uint32_t speckle(uint32_t x, uint32_t y, uint32_t seed, int r, int g, int b, int amount,
+                        int a = 255) {
+    int d = (int)(hash(x, y, seed) % (2 * amount + 1)) - amount;
+    return rgba(r + d, g + d, b + d, a);
+}
+
+void generateBlockTexture(const std::string& name, uint32_t size, uint32_t* pixels) {
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            uint32_t& p = pixels[y * size + x];
+            if (name == "dirt") {
+                p = speckle(x, y, 1, 134, 96, 67, 18);
+            } else if (name == "grass_top") {
+                p = speckle(x, y, 2, 95, 159, 53, 22);
+            } else if (name == "grass_side") {
+                // Grass hangs a ragged 2-4 texels over the dirt.
+                uint32_t fringe = 2 + hash(x, 0, 3) % 3;
+                p = y < fringe ? speckle(x, y, 2, 95, 159, 53, 22)
+                               : speckle(x, y, 1, 134, 96, 67, 18);
+            } else if (name == "stone") {
+                p = speckle(x, y, 4, 125, 125, 125, 14);
+                if (hash(x / 2, y / 2, 5) % 9 == 0) p = speckle(x, y, 6, 98, 98, 98, 8);
+            } else if (name == "water") {
+                p = speckle(x, y, 7, 48, 92, 190, 10, 150);
+            } else if (name == "glass") {
+                bool frame = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+                p = frame ? rgba(210, 225, 230) : rgba(200, 225, 235, 48);
+            } else if (name == "leaves") {
+                // Holes are fully transparent, for the cutout layer.
+                p = hash(x, y, 8) % 10 < 3 ? rgba(0, 0, 0, 0) : speckle(x, y, 9, 58, 122, 40, 20);
+            } else {
+                bool odd = ((x * 2 / size) ^ (y * 2 / size)) & 1;
+                p = odd ? rgba(0, 0, 0) : rgba(255, 0, 255);
+            }
+        }
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Fills size*size RGBA8 sRGB texels (R in the low byte) for a block texture.
+// Textures are generated from their name, so every run produces the same
+// images. Unknown names get the magenta "missing" checkerboard.
+void generateBlockTexture(const std::string& name, uint32_t size, uint32_t* pixels);
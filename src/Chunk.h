@@ -1,18 +1,80 @@
 #pragma once
 #include <array>
+#include <glm/glm.hpp>
 #include "BlockRegistry.h"
+#include "ChunkLayout.h"
 
 struct Voxel {
     BlockRegistry::BlockID type = 0; // 0 == air
 };
 
-class Chunk {
+// A block of SX * SY * SZ voxels (Y up). The dimensions are template
+// parameters so the layout's index math and the mesher's loops fold to
+// constants for whichever shape a build uses; see Chunk below.
+template <int SX, int SY, int SZ>
+class BasicChunk {
 public:
-    static const int SIZE = 16;
-    Chunk();
+    static constexpr int SIZE_X = SX;
+    static constexpr int SIZE_Y = SY;
+    static constexpr int SIZE_Z = SZ;
+    static constexpr int VOLUME = SX * SY * SZ;
+    // Local height of the test terrain's grass, the same for every shape.
+    static constexpr int GROUND_LEVEL = (SY < 16 ? SY : 16) / 2;
+    using Layout = SelectedChunkLayout<SX, SY, SZ>;
+
+    glm::ivec3 position{0}; // chunk coordinates, in units of dims()
+    BasicChunk();
+    static constexpr glm::ivec3 dims() { return glm::ivec3(SX, SY, SZ); }
+    // All air at position 0, as if freshly constructed.
+    void clear();
     void generateTestData();
-    Voxel get(int x, int y, int z) const;
+    // Inline so the layout's index math folds into the caller's loops.
+    Voxel get(int x, int y, int z) const { return voxels[index(x, y, z)]; }
+    void set(int x, int y, int z, Voxel v) { voxels[index(x, y, z)] = v; }
+    // Storage order is Layout's (linear unless VOXEL_CHUNK_LAYOUT says otherwise).
+    static int index(int x, int y, int z) { return Layout::index(x, y, z); }
+
+    // Bulk edits over the box [lo, hi) in local voxel coordinates, clipped to
+    // the chunk. With a linear layout they run on whole rows (and on whole
+    // layers when the box spans them) through the kernels in VoxelRows.h.
+    void fillBox(glm::ivec3 lo, glm::ivec3 hi, Voxel v);
+    // Every voxel whose centre lies within radius of centre.
+    void fillSphere(glm::vec3 centre, float radius, Voxel v);
+    void replace(glm::ivec3 lo, glm::ivec3 hi, Voxel from, Voxel to);
+    size_t count(glm::ivec3 lo, glm::ivec3 hi, Voxel type) const;
+    // Copies the size-voxel box at srcLo in src to dstLo here, clipped to both
+    // chunks. src may be this chunk, with the boxes overlapping.
+    void copyRegion(const BasicChunk& src, glm::ivec3 srcLo, glm::ivec3 dstLo, glm::ivec3 size);
+    // Stamps a dense box of block ids (X fastest, then Y, then Z) with its
+    // first corner at lo, clipped to the chunk. Air in the box leaves the
+    // chunk's voxel as it is.
+    void paste(const BlockRegistry::BlockID* src, glm::ivec3 size, glm::ivec3 lo);
+
 private:
-    std::array<Voxel, SIZE*SIZE*SIZE> voxels;
-    int index(int x, int y, int z) const;
+    static_assert(sizeof(Voxel) == sizeof(BlockRegistry::BlockID), "bulk operations treat voxels as block ids");
+    std::array<Voxel, VOLUME> voxels;
+
+    BlockRegistry::BlockID* ids() { return &voxels[0].type; }
+    const BlockRegistry::BlockID* ids() const { return &voxels[0].type; }
+    static bool clip(glm::ivec3& lo, glm::ivec3& hi);
+    // Calls op(firstIndex, count) for contiguous runs covering [lo, hi),
+    // which must already be clipped.
+    template <class Op>
+    static void forEachRun(const glm::ivec3& lo, const glm::ivec3& hi, Op op);
 };
+
+#include "Chunk.tpp"
+
+// The chunk shape the engine is built with: 16x16x16 unless VOXEL_CHUNK_DIMS
+// in CMake picks 32x32x32 or the 32x256x32 column.
+#ifndef VOXEL_CHUNK_SIZE_X
+#define VOXEL_CHUNK_SIZE_X 16
+#endif
+#ifndef VOXEL_CHUNK_SIZE_Y
+#define VOXEL_CHUNK_SIZE_Y 16
+#endif
+#ifndef VOXEL_CHUNK_SIZE_Z
+#define VOXEL_CHUNK_SIZE_Z 16
+#endif
+
+using Chunk = BasicChunk<VOXEL_CHUNK_SIZE_X, VOXEL_CHUNK_SIZE_Y, VOXEL_CHUNK_SIZE_Z>;
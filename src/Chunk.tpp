@@ -0,0 +1,173 @@
+#pragma once
+#include "Profiler.h"
+#include "VoxelRows.h"
+#include <algorithm>
+#include <cmath>
+
+template <int SX, int SY, int SZ>
+BasicChunk<SX, SY, SZ>::BasicChunk() {
+    voxels.fill({0});
+}
+
+template <int SX, int SY, int SZ>
+void BasicChunk<SX, SY, SZ>::clear() {
+    position = glm::ivec3(0);
+    voxels.fill({0});
+}
+
+template <int SX, int SY, int SZ>
+void BasicChunk<SX, SY, SZ>::generateTestData() {
+    PROFILE_ZONE("Chunk::generateTestData");
+    // Every fourth chunk or so gets a round pond two blocks deep, with a
+    // hedge of leaves on its far side.
+    const bool pond = ((position.x * 7 + position.z * 13) & 3) == 0;
+    const int ground = GROUND_LEVEL;
+    for (int z = 0; z < SZ; ++z) {
+        for (int y = 0; y < SY; ++y) {
+            for (int x = 0; x < SX; ++x) {
+                int dx = x - SX / 2, dz = z - SZ / 2;
+                int r2 = dx * dx + dz * dz;
+                if (pond && y == ground && r2 >= 25 && r2 < 36 && dz > 0) {
+                    voxels[index(x, y, z)].type = 6;
+                    continue;
+                }
+                // Grass over three layers of dirt over stone (see PixelGame's block ids).
+                if (y >= ground) continue;
+                if (pond && r2 < 16 && y >= ground - 2) {
+                    voxels[index(x, y, z)].type = 4;
+                } else if (y == ground - 1) {
+                    voxels[index(x, y, z)].type = 2;
+                } else if (y >= ground - 4) {
+                    voxels[index(x, y, z)].type = 1;
+                } else {
+                    voxels[index(x, y, z)].type = 3;
+                }
+            }
+        }
+    }
+}
+
+template <int SX, int SY, int SZ>
+bool BasicChunk<SX, SY, SZ>::clip(glm::ivec3& lo, glm::ivec3& hi) {
+    lo = glm::max(lo, glm::ivec3(0));
+    hi = glm::min(hi, dims());
+    return lo.x < hi.x && lo.y < hi.y && lo.z < hi.z;
+}
+
+// A box spanning whole rows is one run per layer, and one run in total when
+// it spans whole layers too. Other layouts get one call per voxel.
+template <int SX, int SY, int SZ>
+template <class Op>
+void BasicChunk<SX, SY, SZ>::forEachRun(const glm::ivec3& lo, const glm::ivec3& hi, Op op) {
+    if constexpr (Layout::ROWS_CONTIGUOUS) {
+        const size_t row = size_t(hi.x - lo.x);
+        if (row == size_t(SX) && lo.y == 0 && hi.y == SY) {
+            op(size_t(index(0, 0, lo.z)), row * SY * size_t(hi.z - lo.z));
+        } else if (row == size_t(SX)) {
+            for (int z = lo.z; z < hi.z; ++z) op(size_t(index(0, lo.y, z)), row * size_t(hi.y - lo.y));
+        } else {
+            for (int z = lo.z; z < hi.z; ++z)
+                for (int y = lo.y; y < hi.y; ++y) op(size_t(index(lo.x, y, z)), row);
+        }
+    } else {
+        for (int z = lo.z; z < hi.z; ++z)
+            for (int y = lo.y; y < hi.y; ++y)
+                for (int x = lo.x; x < hi.x; ++x) op(size_t(index(x, y, z)), size_t(1));
+    }
+}
+
+template <int SX, int SY, int SZ>
+void BasicChunk<SX, SY, SZ>::fillBox(glm::ivec3 lo, glm::ivec3 hi, Voxel v) {
+    if (!clip(lo, hi)) return;
+    BlockRegistry::BlockID* data = ids();
+    forEachRun(lo, hi, [&](size_t first, size_t n) { fillVoxelRow(data + first, n, v.type); });
+}
+
+template <int SX, int SY, int SZ>
+void BasicChunk<SX, SY, SZ>::fillSphere(glm::vec3 centre, float radius, Voxel v) {
+    if (radius <= 0.f) return;
+    glm::ivec3 lo(glm::floor(centre - glm::vec3(radius))), hi(glm::ceil(centre + glm::vec3(radius)));
+    if (!clip(lo, hi)) return;
+    BlockRegistry::BlockID* data = ids();
+    const float r2 = radius * radius;
+    for (int z = lo.z; z < hi.z; ++z) {
+        const float dz = float(z) + 0.5f - centre.z;
+        for (int y = lo.y; y < hi.y; ++y) {
+            const float dy = float(y) + 0.5f - centre.y;
+            const float rest = r2 - dy * dy - dz * dz;
+            if (rest < 0.f) continue;
+            // Voxels x with |x + 0.5 - centre.x| <= half form one run.
+            const float half = std::sqrt(rest);
+            glm::ivec3 rowLo((int)std::ceil(centre.x - half - 0.5f), y, z);
+            glm::ivec3 rowHi((int)std::floor(centre.x + half - 0.5f) + 1, y + 1, z + 1);
+            if (!clip(rowLo, rowHi)) continue;
+            forEachRun(rowLo, rowHi, [&](size_t first, size_t n) { fillVoxelRow(data + first, n, v.type); });
+        }
+    }
+}
+
+template <int SX, int SY, int SZ>
+void BasicChunk<SX, SY, SZ>::replace(glm::ivec3 lo, glm::ivec3 hi, Voxel from, Voxel to) {
+    if (!clip(lo, hi)) return;
+    BlockRegistry::BlockID* data = ids();
+    forEachRun(lo, hi, [&](size_t first, size_t n) { replaceVoxelRow(data + first, n, from.type, to.type); });
+}
+
+template <int SX, int SY, int SZ>
+size_t BasicChunk<SX, SY, SZ>::count(glm::ivec3 lo, glm::ivec3 hi, Voxel type) const {
+    if (!clip(lo, hi)) return 0;
+    const BlockRegistry::BlockID* data = ids();
+    size_t total = 0;
+    forEachRun(lo, hi, [&](size_t first, size_t n) { total += countVoxelRow(data + first, n, type.type); });
+    return total;
+}
+
+template <int SX, int SY, int SZ>
+void BasicChunk<SX, SY, SZ>::copyRegion(const BasicChunk& src, glm::ivec3 srcLo, glm::ivec3 dstLo, glm::ivec3 size) {
+    // Trim the box wherever either end of the copy leaves its chunk.
+    const glm::ivec3 skip = glm::max(glm::max(-srcLo, -dstLo), glm::ivec3(0));
+    srcLo += skip;
+    dstLo += skip;
+    size = glm::min(size - skip, glm::min(dims() - srcLo, dims() - dstLo));
+    if (size.x <= 0 || size.y <= 0 || size.z <= 0) return;
+
+    // Within one chunk, rows are visited from the far end when the
+    // destination comes after the source, like memmove does with bytes.
+    const glm::ivec3 offset = dstLo - srcLo;
+    const bool backwards = &src == this &&
+        (offset.z != 0 ? offset.z > 0 : offset.y != 0 ? offset.y > 0 : offset.x > 0);
+    const BlockRegistry::BlockID* from = src.ids();
+    BlockRegistry::BlockID* to = ids();
+    auto copyRow = [&](int y, int z) {
+        if constexpr (Layout::ROWS_CONTIGUOUS) {
+            copyVoxelRow(to + index(dstLo.x, dstLo.y + y, dstLo.z + z),
+                         from + index(srcLo.x, srcLo.y + y, srcLo.z + z), size_t(size.x));
+        } else {
+            for (int i = 0; i < size.x; ++i) {
+                int x = backwards ? size.x - 1 - i : i;
+                to[index(dstLo.x + x, dstLo.y + y, dstLo.z + z)] = from[index(srcLo.x + x, srcLo.y + y, srcLo.z + z)];
+            }
+        }
+    };
+    for (int j = 0; j < size.z; ++j)
+        for (int i = 0; i < size.y; ++i)
+            backwards ? copyRow(size.y - 1 - i, size.z - 1 - j) : copyRow(i, j);
+}
+
+template <int SX, int SY, int SZ>
+void BasicChunk<SX, SY, SZ>::paste(const BlockRegistry::BlockID* src, glm::ivec3 size, glm::ivec3 lo) {
+    glm::ivec3 clipLo = lo, clipHi = lo + size;
+    if (!clip(clipLo, clipHi)) return;
+    BlockRegistry::BlockID* to = ids();
+    const int n = clipHi.x - clipLo.x;
+    for (int z = clipLo.z; z < clipHi.z; ++z)
+        for (int y = clipLo.y; y < clipHi.y; ++y) {
+            const BlockRegistry::BlockID* row =
+                src + (size_t(clipLo.x - lo.x) + size_t(y - lo.y) * size.x + size_t(z - lo.z) * size.x * size.y);
+            if constexpr (Layout::ROWS_CONTIGUOUS) {
+                pasteVoxelRow(to + index(clipLo.x, y, z), row, size_t(n));
+            } else {
+                for (int x = 0; x < n; ++x) pasteVoxelRow(to + index(clipLo.x + x, y, z), row + x, 1);
+            }
+        }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// Voxel orderings inside a chunk of SX * SY * SZ voxels. Each maps (x, y, z)
+// inside the chunk to a unique index below SX * SY * SZ. Chunk uses the one
+// picked by VOXEL_CHUNK_LAYOUT; the others stay available for benchmarks.
+// ROWS_CONTIGUOUS says whether an X run is a contiguous span of indices, which
+// lets Chunk's bulk operations work on whole rows.
+
+// x + y*SX + z*SX*SY: X runs are contiguous, a step in Z jumps a whole layer.
+template <int SX, int SY, int SZ>
+struct LinearLayout {
+    static constexpr const char* NAME = "linear";
+    static constexpr bool ROWS_CONTIGUOUS = true;
+    static constexpr int index(int x, int y, int z) { return x + y * SX + z * SX * SY; }
+};
+
+// Z-order curve: the bits of x, y and z interleaved, so all six neighbours
+// of most voxels are a few cache lines away at most. Uses BMI2 pdep where the
+// compiler targets it and small spread tables otherwise. Cubic chunks only.
+template <int SX, int SY, int SZ>
+struct MortonLayout {
+    static_assert(SX == SY && SY == SZ, "Morton layout needs a cubic chunk");
+    static constexpr int S = SX;
+    static_assert(S > 0 && (S & (S - 1)) == 0 && S <= 1024, "Morton layout needs a power-of-two size");
+    static constexpr const char* NAME = "morton";
+    static constexpr bool ROWS_CONTIGUOUS = false;
+
+    static int index(int x, int y, int z) {
+#if defined(__BMI2__)
+        return (int)(_pdep_u32((uint32_t)x, 0x49249249u) |
+                     _pdep_u32((uint32_t)y, 0x92492492u) |
+                     _pdep_u32((uint32_t)z, 0x24924924u));
+#else
+        return (int)(SPREAD[x] | (SPREAD[y] << 1) | (SPREAD[z] << 2));
+#endif
+    }
+
+private:
+    // v with two zero bits inserted after each of its bits.
+    static constexpr uint32_t spread(uint32_t v) {
+        uint32_t out = 0;
+        for (int bit = 0; (1 << bit) < S; bit++) out |= ((v >> bit) & 1u) << (3 * bit);
+        return out;
+    }
+    static constexpr std::array<uint32_t, S> makeSpread() {
+        std::array<uint32_t, S> t{};
+        for (int i = 0; i < S; i++) t[i] = spread((uint32_t)i);
+        return t;
+    }
+    static constexpr std::array<uint32_t, S> SPREAD = makeSpread();
+};
+
+// 4^3 bricks of 64 voxels (one cache line of one-byte voxels), linear inside
+// a brick and linear across bricks.
+template <int SX, int SY, int SZ>
+struct BrickedLayout {
+    static_assert(SX % 4 == 0 && SY % 4 == 0 && SZ % 4 == 0, "Bricked layout needs sizes divisible by 4");
+    static constexpr const char* NAME = "bricked";
+    static constexpr bool ROWS_CONTIGUOUS = false;
+    static constexpr int BRICKS_X = SX / 4;
+    static constexpr int BRICKS_Y = SY / 4;
+    static constexpr int index(int x, int y, int z) {
+        int brick = (x >> 2) + (y >> 2) * BRICKS_X + (z >> 2) * BRICKS_X * BRICKS_Y;
+        return brick * 64 + (x & 3) + (y & 3) * 4 + (z & 3) * 16;
+    }
+};
+
+// 0 = linear, 1 = Morton, 2 = bricked. Set through the VOXEL_CHUNK_LAYOUT
+// CMake option.
+#ifndef VOXEL_CHUNK_LAYOUT
+#define VOXEL_CHUNK_LAYOUT 0
+#endif
+
+template <int SX, int SY, int SZ>
+using SelectedChunkLayout =
+#if VOXEL_CHUNK_LAYOUT == 1
+    MortonLayout<SX, SY, SZ>;
+#elif VOXEL_CHUNK_LAYOUT == 2
+    BrickedLayout<SX, SY, SZ>;
+#else
+    LinearLayout<SX, SY, SZ>;
+#endif
@@ -0,0 +1,64 @@
+#include "ChunkPool.h"
+#include <stdexcept>
+
+ChunkPool::ChunkPool(size_t memoryCapBytes)
+    : maxSlabs(memoryCapBytes / (sizeof(Slot) * CHUNKS_PER_SLAB)) {
+    if (maxSlabs == 0)
+        throw std::runtime_error("Chunk pool memory cap is smaller than one slab");
+    slabs.reset(new std::unique_ptr<Slot[]>[maxSlabs]);
+    freeSlots.reserve(maxChunks());
+}
+
+ChunkHandle ChunkPool::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (freeSlots.empty()) {
+        size_t slabIndex = slabCount.load(std::memory_order_relaxed);
+        if (slabIndex == maxSlabs) return ChunkHandle{};
+        slabs[slabIndex].reset(new Slot[CHUNKS_PER_SLAB]);
+        slabCount.store(slabIndex + 1, std::memory_order_release);
+        reservedGauge.add((int64_t)(sizeof(Slot) * CHUNKS_PER_SLAB));
+        // Pushed in reverse so slots are handed out in address order.
+        for (uint32_t i = CHUNKS_PER_SLAB; i-- > 0;)
+            freeSlots.push_back((uint32_t)(slabIndex * CHUNKS_PER_SLAB + i));
+    }
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+    Slot& s = slot(index);
+    s.live = true;
+    live++;
+    liveGauge.add(1);
+    ChunkHandle handle{ index, s.generation.load(std::memory_order_relaxed) };
+    // The slot is ours now; clearing it is the slow part, so others may go ahead.
+    lock.unlock();
+    s.chunk.clear();
+    return handle;
+}
+
+void ChunkPool::release(ChunkHandle handle) {
+    if (!handle.valid()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (handle.index / CHUNKS_PER_SLAB >= slabCount.load(std::memory_order_relaxed)) return;
+    Slot& s = slot(handle.index);
+    if (!s.live || s.generation.load(std::memory_order_relaxed) != handle.generation) return;
+    s.live = false;
+    s.generation.store(handle.generation + 1, std::memory_order_release);
+    freeSlots.push_back(handle.index);
+    live--;
+    liveGauge.add(-1);
+}
+
+Chunk* ChunkPool::get(ChunkHandle handle) const {
+    if (!handle.valid() || handle.index / CHUNKS_PER_SLAB >= slabCount.load(std::memory_order_acquire))
+        return nullptr;
+    Slot& s = slot(handle.index);
+    return s.generation.load(std::memory_order_acquire) == handle.generation ? &s.chunk : nullptr;
+}
+
+size_t ChunkPool::liveCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return live;
+}
+
+size_t ChunkPool::reservedBytes() const {
+    return slabCount.load(std::memory_order_acquire) * CHUNKS_PER_SLAB * sizeof(Slot);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "Chunk.h"
+#include "Metrics.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Names a chunk in a ChunkPool. The generation changes every time the slot is
+// released, so a handle kept past its chunk's unload resolves to nullptr
+// instead of to whatever chunk reused the slot.
+struct ChunkHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+    bool valid() const { return index != UINT32_MAX; }
+    bool operator==(const ChunkHandle& o) const { return index == o.index && generation == o.generation; }
+};
+
+// Fixed-address storage for chunks. Slots are carved out of slabs of
+// CHUNKS_PER_SLAB that are allocated on demand and never moved or freed until
+// the pool is destroyed, so a Chunk* stays valid for the pool's lifetime and
+// released slots are recycled through a free list without touching the heap.
+// The memory cap bounds how many slabs may exist; it is rounded down to whole
+// slabs, and a cap below one slab is rejected.
+//
+// acquire() and release() lock; get() doesn't, so workers can resolve handles
+// freely. A chunk must not be released while a job still uses it.
+class ChunkPool {
+public:
+    static constexpr uint32_t CHUNKS_PER_SLAB = 64;
+    static constexpr size_t DEFAULT_MEMORY_CAP = size_t(256) << 20;
+
+    explicit ChunkPool(size_t memoryCapBytes = DEFAULT_MEMORY_CAP);
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator=(const ChunkPool&) = delete;
+
+    // An empty chunk at position 0. Returns an invalid handle once the memory
+    // cap is reached and no slot is free.
+    ChunkHandle acquire();
+    // Stale or invalid handles are ignored.
+    void release(ChunkHandle handle);
+    Chunk* get(ChunkHandle handle) const;
+
+    size_t liveCount() const;
+    size_t maxChunks() const { return maxSlabs * CHUNKS_PER_SLAB; }
+    size_t reservedBytes() const;
+
+private:
+    struct Slot {
+        Chunk                 chunk;
+        std::atomic<uint32_t> generation{0};
+        bool                  live = false; // guarded by mutex
+    };
+
+    size_t                                    maxSlabs;
+    std::unique_ptr<std::unique_ptr<Slot[]>[]> slabs;      // maxSlabs entries, filled in order
+    std::atomic<size_t>                       slabCount{0};
+    mutable std::mutex                        mutex;
+    std::vector<uint32_t>                     freeSlots;  // reserved for maxChunks(), never grows
+    size_t                                    live = 0;
+    Gauge&                                    liveGauge = Metrics::gauge("chunk_pool_live", "Chunks held in the chunk pool");
+    Gauge&                                    reservedGauge = Metrics::gauge("chunk_pool_reserved_bytes", "Bytes of chunk pool slabs");
+
+    Slot& slot(uint32_t index) const { return slabs[index / CHUNKS_PER_SLAB][index % CHUNKS_PER_SLAB]; }
+};
@@ -0,0 +1,53 @@
+#include "ChunkVisibility.h"
+
+uint64_t ChunkVisibilityGraph::key(const glm::ivec3& p) {
+    return (uint64_t(uint32_t(p.x) & 0x1FFFFF) << 42) |
+           (uint64_t(uint32_t(p.y) & 0x1FFFFF) << 21) |
+            uint64_t(uint32_t(p.z) & 0x1FFFFF);
+}
+
+int32_t ChunkVisibilityGraph::find(const glm::ivec3& p) const {
+    auto it = lookup.find(key(p));
+    return it == lookup.end() ? -1 : static_cast<int32_t>(it->second);
+}
+
+void ChunkVisibilityGraph::build(const std::vector<glm::ivec3>& chunkPositions,
+                                 const std::vector<ChunkConnectivity>& chunkConnectivity) {
+    positions = chunkPositions;
+    connectivity = chunkConnectivity;
+    lookup.clear();
+    for (uint32_t i = 0; i < positions.size(); ++i) lookup[key(positions[i])] = i;
+}
+
+size_t ChunkVisibilityGraph::findVisible(const glm::ivec3& cameraChunk,
+                                         std::vector<uint8_t>& visible) {
+    static const glm::ivec3 offsets[FACE_COUNT] = {
+        { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }
+    };
+    int32_t start = find(cameraChunk);
+    if (start < 0) {
+        visible.assign(positions.size(), 1);
+        return positions.size();
+    }
+
+    // A chunk is only expanded from the first path that reaches it.
+    visible.assign(positions.size(), 0);
+    visible[start] = 1;
+    size_t count = 1;
+    queue.clear();
+    queue.push_back({ (uint32_t)start, -1, 0 });
+    for (size_t head = 0; head < queue.size(); ++head) {
+        Step step = queue[head];
+        for (int face = 0; face < FACE_COUNT; ++face) {
+            if (step.travelled & (1 << oppositeFace(face))) continue;
+            if (step.from >= 0 && !connectivity[step.chunk].connected(step.from, face)) continue;
+            int32_t next = find(positions[step.chunk] + offsets[face]);
+            if (next < 0 || visible[next]) continue;
+            visible[next] = 1;
+            count++;
+            queue.push_back({ (uint32_t)next, (int8_t)oppositeFace(face),
+                              (uint8_t)(step.travelled | (1 << face)) });
+        }
+    }
+    return count;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "Chunk.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+enum ChunkFace : uint8_t {
+    FACE_NEG_X, FACE_POS_X,
+    FACE_NEG_Y, FACE_POS_Y,
+    FACE_NEG_Z, FACE_POS_Z,
+    FACE_COUNT
+};
+
+inline ChunkFace oppositeFace(int face) { return ChunkFace(face ^ 1); }
+
+// Which pairs of a chunk's six faces can see each other through connected
+// non-opaque voxels.
+struct ChunkConnectivity {
+    uint64_t pairs = 0; // bit a * FACE_COUNT + b
+
+    bool connected(int a, int b) const { return (pairs >> (a * FACE_COUNT + b)) & 1; }
+    void connect(int a, int b) {
+        pairs |= 1ull << (a * FACE_COUNT + b);
+        pairs |= 1ull << (b * FACE_COUNT + a);
+    }
+};
+
+// Flood-fills the chunk's non-opaque voxels (BlockView::opaque) and connects
+// every pair of faces that one air region touches. Run once per meshing.
+template <class ChunkT>
+ChunkConnectivity computeConnectivity(const ChunkT& chunk);
+
+// Cave culling: a breadth-first walk from the camera's chunk that only crosses
+// a chunk between faces its connectivity links, and never turns back along an
+// axis it has already travelled. Chunks it does not reach are hidden behind
+// solid terrain.
+class ChunkVisibilityGraph {
+public:
+    // Chunk i sits at positions[i] (chunk coordinates) with connectivity[i].
+    void build(const std::vector<glm::ivec3>& positions,
+               const std::vector<ChunkConnectivity>& connectivity);
+    // Fills visible[i] with 1 for every potentially visible chunk. When the
+    // camera is outside the loaded chunks everything is visible.
+    size_t findVisible(const glm::ivec3& cameraChunk, std::vector<uint8_t>& visible);
+
+private:
+    std::vector<glm::ivec3>              positions;
+    std::vector<ChunkConnectivity>       connectivity;
+    std::unordered_map<uint64_t, uint32_t> lookup; // packed position -> chunk index
+
+    struct Step {
+        uint32_t chunk;
+        int8_t   from;      // face it was entered through, -1 for the camera chunk
+        uint8_t  travelled; // faces left through so far on the way here
+    };
+    std::vector<Step> queue;
+
+    static uint64_t key(const glm::ivec3& p);
+    int32_t find(const glm::ivec3& p) const;
+};
+
+#include "ChunkVisibility.tpp"
@@ -0,0 +1,57 @@
+#pragma once
+#include "BlockRegistry.h"
+
+template <class ChunkT>
+ChunkConnectivity computeConnectivity(const ChunkT& chunk) {
+    constexpr int SX = ChunkT::SIZE_X, SY = ChunkT::SIZE_Y, SZ = ChunkT::SIZE_Z;
+    const BlockView blocks = BlockRegistry::view();
+
+    // Reused by every call on this thread, so meshing workers do not allocate
+    // per chunk once the buffers have grown.
+    struct Scratch {
+        std::vector<uint8_t> seen;
+        std::vector<int>     stack;
+    };
+    thread_local Scratch scratch;
+    std::vector<uint8_t>& seen = scratch.seen;
+    std::vector<int>& stack = scratch.stack;
+    seen.assign(ChunkT::VOLUME, 0);
+
+    ChunkConnectivity result;
+    for (int start = 0; start < ChunkT::VOLUME; ++start) {
+        int sx = start % SX, sy = (start / SX) % SY, sz = start / (SX * SY);
+        if (seen[start] || blocks.opaque(chunk.get(sx, sy, sz).type)) continue;
+
+        // One connected air region: note every face it reaches.
+        uint8_t faces = 0;
+        seen[start] = 1;
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int i = stack.back();
+            stack.pop_back();
+            int x = i % SX, y = (i / SX) % SY, z = i / (SX * SY);
+            if (x == 0) faces |= 1 << FACE_NEG_X;
+            if (x == SX - 1) faces |= 1 << FACE_POS_X;
+            if (y == 0) faces |= 1 << FACE_NEG_Y;
+            if (y == SY - 1) faces |= 1 << FACE_POS_Y;
+            if (z == 0) faces |= 1 << FACE_NEG_Z;
+            if (z == SZ - 1) faces |= 1 << FACE_POS_Z;
+
+            const int nx[6] = { x - 1, x + 1, x, x, x, x };
+            const int ny[6] = { y, y, y - 1, y + 1, y, y };
+            const int nz[6] = { z, z, z, z, z - 1, z + 1 };
+            for (int n = 0; n < 6; ++n) {
+                if (nx[n] < 0 || nx[n] >= SX || ny[n] < 0 || ny[n] >= SY || nz[n] < 0 || nz[n] >= SZ)
+                    continue;
+                int j = nx[n] + ny[n] * SX + nz[n] * SX * SY;
+                if (seen[j] || blocks.opaque(chunk.get(nx[n], ny[n], nz[n]).type)) continue;
+                seen[j] = 1;
+                stack.push_back(j);
+            }
+        }
+        for (int a = 0; a < FACE_COUNT; ++a)
+            for (int b = a; b < FACE_COUNT; ++b)
+                if ((faces >> a & 1) && (faces >> b & 1)) result.connect(a, b);
+    }
+    return result;
+}
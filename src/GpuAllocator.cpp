@@ -0,0 +1,229 @@
+#include "GpuAllocator.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits,
+                        VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) &&
+            (memProps.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    }
+    throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+// Sizes are rounded up to the pool alignment, so every offset handed out is a
+// multiple of it as well (the alignment need not be a power of two).
+static VkDeviceSize alignUp(VkDeviceSize v, VkDeviceSize a) {
+    return (v + a - 1) / a * a;
+}
+
+void GpuBufferPool::init(VkDevice dev, VkPhysicalDevice physDev,
+                         VkBufferUsageFlags usageFlags, VkDeviceSize defaultBlockSize,
+                         VkDeviceSize align, uint32_t blockLimit) {
+    device = dev;
+    physicalDevice = physDev;
+    usage = usageFlags;
+    alignment = std::max<VkDeviceSize>(align, 1);
+    blockSize = alignUp(defaultBlockSize, alignment);
+    maxBlocks = blockLimit;
+    if (!createBlock(blockSize))
+        throw std::runtime_error("Failed to create GPU buffer pool");
+}
+
+void GpuBufferPool::destroy() {
+    for (auto& b : blocks) {
+        if (b.buffer == VK_NULL_HANDLE) continue;
+        vkDestroyBuffer(device, b.buffer, nullptr);
+        vkFreeMemory(device, b.memory, nullptr);
+    }
+    blocks.clear();
+}
+
+bool GpuBufferPool::createBlock(VkDeviceSize size) {
+    // Reuse a slot released by releaseEmptyBlocks so block indices stay stable.
+    size_t slot = 0;
+    size_t live = 0;
+    while (slot < blocks.size() && blocks[slot].buffer != VK_NULL_HANDLE) slot++;
+    for (auto& b : blocks) if (b.buffer != VK_NULL_HANDLE) live++;
+    if (live >= maxBlocks) return false;
+
+    Block block;
+    block.size = size;
+    VkBufferCreateInfo bi{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bi.size = size;
+    bi.usage = usage;
+    bi.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bi, nullptr, &block.buffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pool block buffer");
+
+    VkMemoryRequirements memReq;
+    vkGetBufferMemoryRequirements(device, block.buffer, &memReq);
+    VkMemoryAllocateInfo mai{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    mai.allocationSize = memReq.size;
+    mai.memoryTypeIndex = findMemoryType(physicalDevice, memReq.memoryTypeBits,
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkAllocateMemory(device, &mai, nullptr, &block.memory) != VK_SUCCESS) {
+        vkDestroyBuffer(device, block.buffer, nullptr);
+        return false;
+    }
+    vkBindBufferMemory(device, block.buffer, block.memory, 0);
+    block.freeRanges[0] = size;
+
+    if (slot < blocks.size()) blocks[slot] = std::move(block);
+    else blocks.push_back(std::move(block));
+    return true;
+}
+
+bool GpuBufferPool::allocateFrom(uint32_t blockIndex, VkDeviceSize size, GpuAllocation& out) {
+    Block& b = blocks[blockIndex];
+    if (b.buffer == VK_NULL_HANDLE) return false;
+    auto best = b.freeRanges.end();
+    for (auto it = b.freeRanges.begin(); it != b.freeRanges.end(); ++it) {
+        if (it->second >= size && (best == b.freeRanges.end() || it->second < best->second))
+            best = it;
+    }
+    if (best == b.freeRanges.end()) return false;
+    out = take(blockIndex, best, size);
+    return true;
+}
+
+// First fit from the bottom of the block, ending at or before limit.
+bool GpuBufferPool::allocateBelow(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize limit,
+                                  GpuAllocation& out) {
+    Block& b = blocks[blockIndex];
+    for (auto it = b.freeRanges.begin(); it != b.freeRanges.end() && it->first + size <= limit; ++it) {
+        if (it->second < size) continue;
+        out = take(blockIndex, it, size);
+        return true;
+    }
+    return false;
+}
+
+GpuAllocation GpuBufferPool::take(uint32_t blockIndex, std::map<VkDeviceSize, VkDeviceSize>::iterator range,
+                                  VkDeviceSize size) {
+    Block& b = blocks[blockIndex];
+    VkDeviceSize offset = range->first;
+    VkDeviceSize remaining = range->second - size;
+    b.freeRanges.erase(range);
+    if (remaining > 0) b.freeRanges[offset + size] = remaining;
+    b.allocations[offset] = size;
+    b.used += size;
+    return { blockIndex, offset, size };
+}
+
+GpuAllocation GpuBufferPool::allocate(VkDeviceSize requested) {
+    GpuAllocation alloc;
+    VkDeviceSize size = alignUp(std::max<VkDeviceSize>(requested, 1), alignment);
+    for (uint32_t i = 0; i < blocks.size(); i++)
+        if (allocateFrom(i, size, alloc)) return alloc;
+
+    // Oversized requests get a block of their own.
+    if (!createBlock(std::max(blockSize, size))) return alloc;
+    for (uint32_t i = 0; i < blocks.size(); i++)
+        if (blocks[i].allocations.empty() && allocateFrom(i, size, alloc)) return alloc;
+    return alloc;
+}
+
+void GpuBufferPool::free(const GpuAllocation& alloc) {
+    if (!alloc.valid()) return;
+    Block& b = blocks[alloc.block];
+    auto live = b.allocations.find(alloc.offset);
+    if (live == b.allocations.end()) return;
+    VkDeviceSize offset = live->first;
+    VkDeviceSize size = live->second;
+    b.allocations.erase(live);
+    b.used -= size;
+
+    // Coalesce with the free neighbours on either side.
+    auto next = b.freeRanges.lower_bound(offset);
+    if (next != b.freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = b.freeRanges.erase(next);
+    }
+    if (next != b.freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    b.freeRanges[offset] = size;
+}
+
+GpuPoolStats GpuBufferPool::stats() const {
+    GpuPoolStats s;
+    VkDeviceSize freeBytes = 0;
+    for (auto& b : blocks) {
+        if (b.buffer == VK_NULL_HANDLE) continue;
+        s.blockCount++;
+        s.allocationCount += b.allocations.size();
+        s.capacity += b.size;
+        s.used += b.used;
+        for (auto& r : b.freeRanges) {
+            freeBytes += r.second;
+            s.largestFreeRange = std::max(s.largestFreeRange, r.second);
+        }
+    }
+    if (freeBytes > 0)
+        s.fragmentation = 1.f - float(s.largestFreeRange) / float(freeBytes);
+    return s;
+}
+
+std::vector<GpuBufferPool::Move> GpuBufferPool::planDefragment(size_t maxMoves) {
+    std::vector<Move> moves;
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < blocks.size(); i++)
+        if (blocks[i].buffer != VK_NULL_HANDLE && !blocks[i].allocations.empty())
+            order.push_back(i);
+    if (order.empty()) return moves;
+
+    // The sparser half of the blocks is drained into the fuller half, which
+    // is compacted first. Sources are always ranges that were live before
+    // planning and destinations always free ones, so no planned destination
+    // is ever moved again and no copy reads another copy's output.
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return blocks[a].used < blocks[b].used;
+    });
+    size_t half = order.size() / 2;
+
+    // Compaction: from the top of each kept block down, ranges move into the
+    // lowest hole below them that fits, so free space gathers at the end.
+    // With a single block (GPU-driven mode) this is the only step.
+    for (size_t d = half; d < order.size() && moves.size() < maxMoves; d++) {
+        auto live = blocks[order[d]].allocations; // copy: destinations are added as we go
+        for (auto a = live.rbegin(); a != live.rend() && moves.size() < maxMoves; ++a) {
+            GpuAllocation to;
+            if (allocateBelow(order[d], a->second, a->first, to))
+                moves.push_back({ { order[d], a->first, a->second }, to });
+        }
+    }
+
+    for (size_t s = 0; s < half && moves.size() < maxMoves; s++) {
+        uint32_t src = order[s];
+        auto live = blocks[src].allocations; // copy: the caller frees these later
+        for (auto& a : live) {
+            if (moves.size() >= maxMoves) break;
+            GpuAllocation to;
+            for (size_t d = order.size(); d-- > half;) {
+                if (allocateFrom(order[d], a.second, to)) break;
+            }
+            if (!to.valid()) continue;
+            moves.push_back({ { src, a.first, a.second }, to });
+        }
+    }
+    return moves;
+}
+
+void GpuBufferPool::releaseEmptyBlocks() {
+    for (size_t i = 1; i < blocks.size(); i++) {
+        Block& b = blocks[i];
+        if (b.buffer == VK_NULL_HANDLE || !b.allocations.empty()) continue;
+        vkDestroyBuffer(device, b.buffer, nullptr);
+        vkFreeMemory(device, b.memory, nullptr);
+        b = Block{};
+    }
+}
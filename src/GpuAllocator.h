@@ -0,0 +1,85 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Picks a memory type allowed by typeBits that has all of the given properties.
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits,
+                        VkMemoryPropertyFlags properties);
+
+// A range carved out of one of a GpuBufferPool's blocks.
+struct GpuAllocation {
+    uint32_t     block = UINT32_MAX;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    bool valid() const { return block != UINT32_MAX; }
+};
+
+struct GpuPoolStats {
+    size_t       blockCount = 0;
+    size_t       allocationCount = 0;
+    VkDeviceSize capacity = 0;         // bytes reserved from the driver
+    VkDeviceSize used = 0;             // bytes handed out
+    VkDeviceSize largestFreeRange = 0;
+    float        fragmentation = 0.f;  // 1 - largestFreeRange / free bytes
+};
+
+// Sub-allocates ranges from a few large device-local VkBuffers so chunk meshes
+// don't each cost a vkAllocateMemory. Each block keeps a coalescing free list
+// (offset -> size) and allocations are placed best-fit. Not thread-safe; the
+// owner serialises access.
+class GpuBufferPool {
+public:
+    struct Move {
+        GpuAllocation from;
+        GpuAllocation to;
+    };
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice,
+              VkBufferUsageFlags usage, VkDeviceSize blockSize,
+              VkDeviceSize alignment, uint32_t maxBlocks = UINT32_MAX);
+    void destroy();
+
+    // Returns an invalid allocation when maxBlocks is reached and nothing fits.
+    GpuAllocation allocate(VkDeviceSize size);
+    void free(const GpuAllocation& alloc);
+
+    VkBuffer buffer(uint32_t block) const { return blocks[block].buffer; }
+    GpuPoolStats stats() const;
+
+    // Plans up to maxMoves relocations that slide ranges down into holes
+    // within each block and drain the sparsest blocks into the free space of
+    // fuller ones. Destinations are already allocated and never overlap a
+    // source; the caller copies the data, repoints its users and then frees
+    // each `from`.
+    std::vector<Move> planDefragment(size_t maxMoves);
+    // Gives fully empty blocks (except the first) back to the driver.
+    void releaseEmptyBlocks();
+
+private:
+    struct Block {
+        VkBuffer       buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize   size = 0;
+        VkDeviceSize   used = 0;
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;  // offset -> size
+        std::map<VkDeviceSize, VkDeviceSize> allocations; // offset -> size
+    };
+
+    VkDevice           device = VK_NULL_HANDLE;
+    VkPhysicalDevice   physicalDevice = VK_NULL_HANDLE;
+    VkBufferUsageFlags usage = 0;
+    VkDeviceSize       blockSize = 0;
+    VkDeviceSize       alignment = 1;
+    uint32_t           maxBlocks = UINT32_MAX;
+    std::vector<Block> blocks;
+
+    bool createBlock(VkDeviceSize size);
+    bool allocateFrom(uint32_t blockIndex, VkDeviceSize size, GpuAllocation& out);
+    bool allocateBelow(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize limit, GpuAllocation& out);
+    GpuAllocation take(uint32_t blockIndex, std::map<VkDeviceSize, VkDeviceSize>::iterator range,
+                       VkDeviceSize size);
+};
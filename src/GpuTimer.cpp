@@ -0,0 +1,104 @@
+#include "GpuTimer.h"
+#include <stdexcept>
+
+void GpuTimer::init(VkDevice dev, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                    uint32_t slotCount, bool statistics) {
+    device = dev;
+    slots.assign(slotCount, Slot{});
+
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, families.data());
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    // Without timestamps there is nothing to anchor statistics to either.
+    if (validBits == 0 || props.limits.timestampPeriod == 0.f) return;
+
+    periodNs = props.limits.timestampPeriod;
+    validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    VkQueryPoolCreateInfo qpci{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    qpci.queryCount = slotCount * QUERIES_PER_SLOT;
+    if (vkCreateQueryPool(device, &qpci, nullptr, &timestampPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create timestamp query pool");
+
+    if (!statistics) return;
+    VkQueryPoolCreateInfo spci{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    spci.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    spci.queryCount = slotCount;
+    spci.pipelineStatistics = STATISTIC_FLAGS;
+    if (vkCreateQueryPool(device, &spci, nullptr, &statisticsPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline statistics query pool");
+}
+
+void GpuTimer::destroy() {
+    vkDestroyQueryPool(device, timestampPool, nullptr);
+    vkDestroyQueryPool(device, statisticsPool, nullptr);
+    timestampPool = VK_NULL_HANDLE;
+    statisticsPool = VK_NULL_HANDLE;
+    slots.clear();
+}
+
+void GpuTimer::beginFrame(VkCommandBuffer cb, uint32_t slot) {
+    recording = slot;
+    Slot& s = slots[slot];
+    s.names.clear();
+    s.recorded = false;
+    s.statistics = false;
+    if (!enabled()) return;
+    vkCmdResetQueryPool(cb, timestampPool, slot * QUERIES_PER_SLOT, QUERIES_PER_SLOT);
+    if (statisticsEnabled()) vkCmdResetQueryPool(cb, statisticsPool, slot, 1);
+    vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, slot * QUERIES_PER_SLOT);
+    s.recorded = true;
+}
+
+void GpuTimer::mark(VkCommandBuffer cb, const char* passName) {
+    Slot& s = slots[recording];
+    if (!s.recorded || s.names.size() >= MAX_MARKS) return;
+    s.names.push_back(passName);
+    vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool,
+                        recording * QUERIES_PER_SLOT + (uint32_t)s.names.size());
+}
+
+void GpuTimer::beginStatistics(VkCommandBuffer cb) {
+    if (!statisticsEnabled() || !slots[recording].recorded) return;
+    vkCmdBeginQuery(cb, statisticsPool, recording, 0);
+    slots[recording].statistics = true;
+}
+
+void GpuTimer::endStatistics(VkCommandBuffer cb) {
+    if (slots[recording].statistics) vkCmdEndQuery(cb, statisticsPool, recording);
+}
+
+bool GpuTimer::collect(uint32_t slot, GpuFrameTimings& out) {
+    Slot& s = slots[slot];
+    if (!s.recorded) return false;
+    // No WAIT bit: a frame whose results are late is dropped, never waited on.
+    uint64_t ts[QUERIES_PER_SLOT];
+    uint32_t queries = (uint32_t)s.names.size() + 1;
+    if (vkGetQueryPoolResults(device, timestampPool, slot * QUERIES_PER_SLOT, queries,
+                              sizeof(ts), ts, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return false;
+    s.recorded = false;
+
+    auto ms = [this](uint64_t from, uint64_t to) { return double((to - from) & validMask) * periodNs / 1e6; };
+    out.passes.clear();
+    for (size_t i = 0; i < s.names.size(); i++)
+        out.passes.push_back({ s.names[i], ms(ts[i], ts[i + 1]) });
+    out.totalMs = ms(ts[0], ts[queries - 1]);
+
+    // Results come back in flag bit order.
+    uint64_t stats[4];
+    out.hasStatistics = s.statistics &&
+        vkGetQueryPoolResults(device, statisticsPool, slot, 1, sizeof(stats), stats,
+                              sizeof(stats), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+    if (out.hasStatistics) {
+        out.vertexInvocations = stats[0];
+        out.clippingInvocations = stats[1];
+        out.clippingPrimitives = stats[2];
+        out.fragmentInvocations = stats[3];
+    }
+    return true;
+}
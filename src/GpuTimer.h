@@ -0,0 +1,79 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <vector>
+
+struct GpuPassTiming {
+    const char* name = nullptr; // as passed to GpuTimer::mark
+    double      ms = 0.0;
+};
+
+// What the GPU spent on one frame. Statistics cover the main render pass and
+// are only filled in when hasStatistics is set.
+struct GpuFrameTimings {
+    std::vector<GpuPassTiming> passes;
+    double   totalMs = -1.0;
+    bool     hasStatistics = false;
+    uint64_t vertexInvocations = 0;
+    uint64_t clippingInvocations = 0;  // primitives that reached the clipper
+    uint64_t clippingPrimitives = 0;   // primitives that came out of it
+    uint64_t fragmentInvocations = 0;
+};
+
+// Per-pass GPU timing from timestamp queries, plus pipeline statistics when
+// the device supports them. Each frame slot owns its own range of queries, so
+// a slot's results are read back only after its fence has signalled, i.e.
+// `slots` frames later, and never stall the queue.
+//
+// Recording a frame: beginFrame(), then mark() at the end of every pass, which
+// closes the pass that started at the previous mark (or at beginFrame).
+class GpuTimer {
+public:
+    static constexpr uint32_t MAX_MARKS = 15; // passes per frame
+
+    // `statistics` requests pipeline statistics; the device feature
+    // pipelineStatisticsQuery must have been enabled.
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+              uint32_t slots, bool statistics);
+    void destroy();
+
+    bool enabled() const { return timestampPool != VK_NULL_HANDLE; }
+    bool statisticsEnabled() const { return statisticsPool != VK_NULL_HANDLE; }
+    // For VkCommandBufferInheritanceInfo when the statistics query is active
+    // while secondaries execute.
+    VkQueryPipelineStatisticFlags statisticFlags() const { return STATISTIC_FLAGS; }
+
+    void beginFrame(VkCommandBuffer cb, uint32_t slot);
+    void mark(VkCommandBuffer cb, const char* passName);
+    // Around the render pass; no-ops without statistics support.
+    void beginStatistics(VkCommandBuffer cb);
+    void endStatistics(VkCommandBuffer cb);
+
+    // Reads a slot recorded earlier without waiting. False when the slot holds
+    // no frame or its results aren't available yet.
+    bool collect(uint32_t slot, GpuFrameTimings& out);
+
+private:
+    static constexpr VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+    static constexpr uint32_t QUERIES_PER_SLOT = MAX_MARKS + 1;
+
+    struct Slot {
+        std::vector<const char*> names; // one per mark
+        bool recorded = false;
+        bool statistics = false;
+    };
+
+    VkDevice          device = VK_NULL_HANDLE;
+    VkQueryPool       timestampPool = VK_NULL_HANDLE;
+    VkQueryPool       statisticsPool = VK_NULL_HANDLE;
+    double            periodNs = 0.0;
+    uint64_t          validMask = 0;
+    std::vector<Slot> slots;
+    uint32_t          recording = 0; // slot between beginFrame and the next beginFrame
+};
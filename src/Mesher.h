@@ -1,6 +1,61 @@
 #pragma once
 #include "Chunk.h"
 #include "VulkanApp.h"
+#include "Metrics.h"
+#include <array>
+#include <mutex>
 #include <vector>
 
-void greedyMesh(const Chunk& chunk, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+// Indices are grouped by render layer: opaque, then cutout, then translucent.
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    uint32_t cutoutIndexCount = 0;
+    uint32_t translucentIndexCount = 0;
+
+    // Empties the buffers but keeps their capacity.
+    void clear();
+};
+
+// Working memory greedyMesh needs besides its output. Reused across calls,
+// it stops allocating once it has grown to the largest chunk seen.
+struct MeshScratch {
+    std::array<std::vector<uint32_t>, 3> layerIndices; // by RenderLayer
+};
+
+// Replaces the contents of `mesh` with the chunk's mesh, keeping the buffers'
+// capacity. The two-argument form uses a scratch owned by the calling thread,
+// so each pool worker keeps its own. Templated on the chunk so its
+// dimensions are loop bounds known at compile time.
+template <class ChunkT>
+void greedyMesh(const ChunkT& chunk, MeshData& mesh, MeshScratch& scratch);
+template <class ChunkT>
+void greedyMesh(const ChunkT& chunk, MeshData& mesh);
+
+// Recycles mesh buffers: acquire() hands out an empty MeshData, pre-sized
+// when new, and release() takes it back once its contents have been uploaded.
+// Recycled buffers keep whatever capacity they grew to, so in steady state
+// meshing into them allocates nothing. Thread-safe.
+class MeshBufferPool {
+public:
+    static constexpr size_t DEFAULT_VERTEX_RESERVE = 2048;
+    static constexpr size_t DEFAULT_INDEX_RESERVE = DEFAULT_VERTEX_RESERVE / 4 * 6;
+
+    explicit MeshBufferPool(size_t maxPooled = 256,
+                            size_t vertexReserve = DEFAULT_VERTEX_RESERVE,
+                            size_t indexReserve = DEFAULT_INDEX_RESERVE);
+    MeshData acquire();
+    void release(MeshData&& mesh);
+    size_t pooled() const;
+
+private:
+    mutable std::mutex    mutex;
+    std::vector<MeshData> free;     // capacity reserved up front, never grows
+    size_t                maxPooled;
+    size_t                vertexReserve;
+    size_t                indexReserve;
+    Counter&              created = Metrics::counter("mesh_buffers_created_total", "MeshData buffers allocated by the pool");
+    Counter&              reused = Metrics::counter("mesh_buffers_reused_total", "MeshData buffers handed out again");
+};
+
+#include "Mesher.tpp"
@@ -0,0 +1,82 @@
+#pragma once
+#include "ChunkVisibility.h"
+#include "Profiler.h"
+
+// Very simplified greedy meshing: merge runs of the same block along X axis
+// for every upward-facing surface of the chunk. A top face is visible when the
+// block above is not opaque and is not the same block (no faces inside a body
+// of water). Quads are sorted into the block's render layer.
+template <class ChunkT>
+void greedyMesh(const ChunkT& chunk, MeshData& mesh, MeshScratch& scratch) {
+    PROFILE_ZONE("greedyMesh");
+    static Counter& meshed = Metrics::counter("mesher_chunks_total", "Chunks meshed");
+    static Counter& quads = Metrics::counter("mesher_quads_total", "Quads emitted by the mesher");
+    // Counts buffer growth, the only heap allocation on this path; it should
+    // stay flat once buffers are recycled.
+    static Counter& allocations = Metrics::counter("mesher_allocations_total",
+                                                   "Mesher buffer growths (heap allocations)");
+    mesh.clear(); // the layer counts below describe this chunk's indices only
+    constexpr int SX = ChunkT::SIZE_X, SY = ChunkT::SIZE_Y, SZ = ChunkT::SIZE_Z;
+    const BlockView blocks = BlockRegistry::view();
+    auto& layers = scratch.layerIndices;
+    for (auto& indices : layers) indices.clear();
+    auto capacities = [&] {
+        return std::array<size_t, 5>{ mesh.vertices.capacity(), mesh.indices.capacity(),
+            layers[0].capacity(), layers[1].capacity(), layers[2].capacity() };
+    };
+    const std::array<size_t, 5> capacityBefore = capacities();
+    auto exposed = [&](int x, int y, int z, BlockRegistry::BlockID type) {
+        BlockRegistry::BlockID above = y + 1 < SY ? chunk.get(x, y + 1, z).type : 0;
+        return above != type && !blocks.opaque(above);
+    };
+    for (int y = 0; y < SY; ++y) {
+        const int yFace = y + 1; // face sits on top of the block
+        for (int z = 0; z < SZ; ++z) {
+            for (int x = 0; x < SX;) {
+                int start = x;
+                BlockRegistry::BlockID type = chunk.get(x, y, z).type;
+                while (x < SX && type != 0 && chunk.get(x, y, z).type == type && exposed(x, y, z, type)) {
+                    ++x;
+                }
+                if (start != x) {
+                    // Create a quad covering [start,x) at height yFace. UVs count
+                    // blocks so the texture repeats once per merged block.
+                    float len = (float)(x - start);
+                    uint32_t material = Vertex::packMaterial(type, FACE_POS_Y);
+                    Vertex v0{{(float)start, (float)yFace, (float)z},   {0, 1, 0}, {0, 0},   material};
+                    Vertex v1{{(float)x,     (float)yFace, (float)z},   {0, 1, 0}, {len, 0}, material};
+                    Vertex v2{{(float)x,     (float)yFace, (float)z + 1}, {0, 1, 0}, {len, 1}, material};
+                    Vertex v3{{(float)start, (float)yFace, (float)z + 1}, {0, 1, 0}, {0, 1},   material};
+                    uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+                    mesh.vertices.push_back(v0);
+                    mesh.vertices.push_back(v1);
+                    mesh.vertices.push_back(v2);
+                    mesh.vertices.push_back(v3);
+                    auto& indices = layers[(size_t)blocks.renderLayer(type)];
+                    indices.push_back(base);
+                    indices.push_back(base + 1);
+                    indices.push_back(base + 2);
+                    indices.push_back(base);
+                    indices.push_back(base + 2);
+                    indices.push_back(base + 3);
+                }
+                if (x == start) ++x; // nothing to merge here; otherwise x starts the next run
+            }
+        }
+    }
+    for (auto& indices : layers)
+        mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+    mesh.cutoutIndexCount = (uint32_t)layers[(size_t)RenderLayer::Cutout].size();
+    mesh.translucentIndexCount = (uint32_t)layers[(size_t)RenderLayer::Translucent].size();
+    meshed.add();
+    quads.add(mesh.vertices.size() / 4);
+    const std::array<size_t, 5> capacityAfter = capacities();
+    for (size_t i = 0; i < capacityAfter.size(); i++)
+        if (capacityAfter[i] != capacityBefore[i]) allocations.add();
+}
+
+template <class ChunkT>
+void greedyMesh(const ChunkT& chunk, MeshData& mesh) {
+    thread_local MeshScratch scratch;
+    greedyMesh(chunk, mesh, scratch);
+}
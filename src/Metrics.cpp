@@ -0,0 +1,141 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+std::mutex Metrics::mutex;
+std::vector<Metrics::Entry> Metrics::entries;
+
+Histogram::Histogram(std::vector<double> upperBounds)
+    : upper(std::move(upperBounds)), buckets(new std::atomic<uint64_t>[upper.size() + 1]) {
+    std::sort(upper.begin(), upper.end());
+    for (size_t i = 0; i <= upper.size(); i++) buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void Histogram::observe(double value) {
+    size_t i = std::lower_bound(upper.begin(), upper.end(), value) - upper.begin();
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    double s = sumValue.load(std::memory_order_relaxed);
+    while (!sumValue.compare_exchange_weak(s, s + value, std::memory_order_relaxed)) {}
+}
+
+double Histogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) return 0.0;
+    double rank = std::min(std::max(p, 0.0), 1.0) * double(n);
+    uint64_t seen = 0;
+    for (size_t i = 0; i <= upper.size(); i++) {
+        uint64_t c = bucketCount(i);
+        if (c > 0 && double(seen + c) >= rank) {
+            double lo = i == 0 ? 0.0 : upper[i - 1];
+            if (i == upper.size()) return lo; // overflow bucket has no upper edge
+            return lo + (upper[i] - lo) * (rank - double(seen)) / double(c);
+        }
+        seen += c;
+    }
+    return upper.empty() ? 0.0 : upper.back();
+}
+
+std::vector<double> Histogram::exponentialBounds(double first, double factor, size_t count) {
+    std::vector<double> bounds;
+    for (double b = first; bounds.size() < count; b *= factor) bounds.push_back(b);
+    return bounds;
+}
+
+Metrics::Entry* Metrics::find(const std::string& name, Kind kind) {
+    for (auto& e : entries) {
+        if (e.name != name) continue;
+        if (e.kind != kind) throw std::runtime_error("Metric " + name + " registered with another type");
+        return &e;
+    }
+    return nullptr;
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* e = find(name, Kind::Counter)) return *e->counter;
+    entries.push_back({ name, help, Kind::Counter, std::make_unique<Counter>(), nullptr, nullptr });
+    return *entries.back().counter;
+}
+
+Gauge& Metrics::gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* e = find(name, Kind::Gauge)) return *e->gauge;
+    entries.push_back({ name, help, Kind::Gauge, nullptr, std::make_unique<Gauge>(), nullptr });
+    return *entries.back().gauge;
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::vector<double>& bounds,
+                              const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* e = find(name, Kind::Histogram)) return *e->histogram;
+    entries.push_back({ name, help, Kind::Histogram, nullptr, nullptr, std::make_unique<Histogram>(bounds) });
+    return *entries.back().histogram;
+}
+
+void Metrics::writePrometheus(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& e : entries) {
+        if (!e.help.empty()) out << "# HELP " << e.name << ' ' << e.help << '\n';
+        switch (e.kind) {
+        case Kind::Counter:
+            out << "# TYPE " << e.name << " counter\n" << e.name << ' ' << e.counter->value() << '\n';
+            break;
+        case Kind::Gauge:
+            out << "# TYPE " << e.name << " gauge\n" << e.name << ' ' << e.gauge->value() << '\n';
+            break;
+        case Kind::Histogram: {
+            const Histogram& h = *e.histogram;
+            out << "# TYPE " << e.name << " histogram\n";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < h.bounds().size(); i++) {
+                cumulative += h.bucketCount(i);
+                out << e.name << "_bucket{le=\"" << h.bounds()[i] << "\"} " << cumulative << '\n';
+            }
+            cumulative += h.bucketCount(h.bounds().size());
+            out << e.name << "_bucket{le=\"+Inf\"} " << cumulative << '\n'
+                << e.name << "_sum " << h.sum() << '\n'
+                << e.name << "_count " << h.count() << '\n';
+            break;
+        }
+        }
+    }
+}
+
+bool Metrics::writePrometheusFile(const std::string& path) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out) return false;
+        writePrometheus(out);
+        if (!out) return false;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str()); // rename() won't replace an existing file here
+#endif
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+std::string Metrics::summaryLine() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& e = entries[i];
+        if (i) ss << ' ';
+        switch (e.kind) {
+        case Kind::Counter: ss << e.name << '=' << e.counter->value(); break;
+        case Kind::Gauge: ss << e.name << '=' << e.gauge->value(); break;
+        case Kind::Histogram:
+            ss << e.name << "{p50=" << e.histogram->percentile(0.5)
+               << ",p95=" << e.histogram->percentile(0.95)
+               << ",p99=" << e.histogram->percentile(0.99) << '}';
+            break;
+        }
+    }
+    return ss.str();
+}
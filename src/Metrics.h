@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Monotonic count of events.
+class Counter {
+public:
+    void add(uint64_t n = 1) { v.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return v.load(std::memory_order_relaxed); }
+private:
+    std::atomic<uint64_t> v{0};
+};
+
+// Current level of something; may go up and down.
+class Gauge {
+public:
+    void set(int64_t value) { v.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { v.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return v.load(std::memory_order_relaxed); }
+private:
+    std::atomic<int64_t> v{0};
+};
+
+// Distribution over fixed bucket bounds. observe() is lock-free; percentiles
+// are interpolated within a bucket, so they are only as fine as the bounds.
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> upperBounds);
+    void observe(double value);
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    double sum() const { return sumValue.load(std::memory_order_relaxed); }
+    // p in [0, 1]. 0 when nothing was observed.
+    double percentile(double p) const;
+    const std::vector<double>& bounds() const { return upper; }
+    // Observations in bucket i (the last bucket is everything above the bounds).
+    uint64_t bucketCount(size_t i) const { return buckets[i].load(std::memory_order_relaxed); }
+
+    // `count` bounds from `first`, each `factor` times the previous one.
+    static std::vector<double> exponentialBounds(double first, double factor, size_t count);
+
+private:
+    std::vector<double>                     upper;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets; // upper.size() + 1
+    std::atomic<uint64_t>                   total{0};
+    std::atomic<double>                     sumValue{0.0};
+};
+
+// Process-wide registry of named metrics. Lookups take a lock, so fetch a
+// metric once and keep the reference; metrics are never removed, so the
+// reference stays valid. Updating a metric is a relaxed atomic operation.
+//
+// Names follow Prometheus conventions (snake_case, unit suffix) so
+// writePrometheus() output can be scraped as-is.
+class Metrics {
+public:
+    static Counter& counter(const std::string& name, const std::string& help = "");
+    static Gauge& gauge(const std::string& name, const std::string& help = "");
+    // `bounds` is only used by the call that creates the histogram.
+    static Histogram& histogram(const std::string& name, const std::vector<double>& bounds,
+                                const std::string& help = "");
+
+    // Prometheus text exposition format.
+    static void writePrometheus(std::ostream& out);
+    // Writes writePrometheus() output to `path` via a temporary file and a
+    // rename, so a scraper never sees a partial file.
+    static bool writePrometheusFile(const std::string& path);
+    // One compact line of every metric, for periodic logging.
+    static std::string summaryLine();
+
+private:
+    enum class Kind { Counter, Gauge, Histogram };
+    struct Entry {
+        std::string                name;
+        std::string                help;
+        Kind                       kind;
+        std::unique_ptr<Counter>   counter;
+        std::unique_ptr<Gauge>     gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+    static std::mutex mutex;
+    static std::vector<Entry> entries; // in registration order
+    static Entry* find(const std::string& name, Kind kind);
+};
@@ -0,0 +1,120 @@
+#include "PipelineCache.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// Prepended to the driver's blob. The driver header does not carry the
+// driver version, and an update may still produce the same pipeline cache UUID.
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+};
+constexpr uint32_t CACHE_MAGIC = 0x43505856; // "VXPC"
+constexpr uint32_t CACHE_VERSION = 1;
+
+FileHeader makeHeader(const VkPhysicalDeviceProperties& props, uint64_t dataSize) {
+    FileHeader h{};
+    h.magic = CACHE_MAGIC;
+    h.version = CACHE_VERSION;
+    h.vendorID = props.vendorID;
+    h.deviceID = props.deviceID;
+    h.driverVersion = props.driverVersion;
+    std::memcpy(h.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+    h.dataSize = dataSize;
+    return h;
+}
+
+bool matches(const FileHeader& h, const VkPhysicalDeviceProperties& props) {
+    return h.magic == CACHE_MAGIC && h.version == CACHE_VERSION &&
+           h.vendorID == props.vendorID && h.deviceID == props.deviceID &&
+           h.driverVersion == props.driverVersion &&
+           std::memcmp(h.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// The driver's own header must agree as well, or it would silently drop the data.
+bool driverBlobMatches(const std::vector<char>& blob, const VkPhysicalDeviceProperties& props) {
+    VkPipelineCacheHeaderVersionOne h;
+    if (blob.size() < sizeof(h)) return false;
+    std::memcpy(&h, blob.data(), sizeof(h));
+    return h.headerSize >= sizeof(h) && h.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           h.vendorID == props.vendorID && h.deviceID == props.deviceID &&
+           std::memcmp(h.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+}
+
+void PipelineCache::init(VkDevice dev, VkPhysicalDevice physicalDevice, const std::string& file) {
+    device = dev;
+    path = file;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+    std::vector<char> blob;
+    std::ifstream in(path, std::ios::binary);
+    FileHeader header{};
+    if (in && in.read(reinterpret_cast<char*>(&header), sizeof(header)) && matches(header, props)) {
+        blob.resize(header.dataSize);
+        if (!in.read(blob.data(), blob.size()) || !driverBlobMatches(blob, props)) blob.clear();
+    }
+    else if (in) {
+        std::cout << "Pipeline cache " << path << " is from another device or driver, rebuilding\n";
+    }
+
+    VkPipelineCacheCreateInfo ci{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    ci.initialDataSize = blob.size();
+    ci.pInitialData = blob.empty() ? nullptr : blob.data();
+    if (vkCreatePipelineCache(device, &ci, nullptr, &cache) != VK_SUCCESS) {
+        // A blob the driver rejects should never keep us from starting.
+        ci.initialDataSize = 0;
+        ci.pInitialData = nullptr;
+        blob.clear();
+        if (vkCreatePipelineCache(device, &ci, nullptr, &cache) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline cache");
+    }
+    loadedBytes = blob.size();
+}
+
+void PipelineCache::destroy() {
+    if (cache == VK_NULL_HANDLE) return;
+    size_t size = 0;
+    std::vector<char> blob;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) == VK_SUCCESS && size > 0) {
+        blob.resize(size);
+        if (vkGetPipelineCacheData(device, cache, &size, blob.data()) != VK_SUCCESS) blob.clear();
+        blob.resize(size);
+    }
+    vkDestroyPipelineCache(device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+    if (blob.empty()) return;
+
+    // Write to a temporary and rename, so a crash mid-write never leaves a
+    // truncated cache behind.
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        FileHeader header = makeHeader(props, blob.size());
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(blob.data(), blob.size());
+        if (!out) {
+            std::cerr << "Failed to write pipeline cache " << tmp << "\n";
+            out.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str()); // rename() won't replace an existing file here
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to replace pipeline cache " << path << "\n";
+        std::remove(tmp.c_str());
+    }
+}
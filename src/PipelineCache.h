@@ -0,0 +1,27 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <string>
+
+// A VkPipelineCache persisted between runs. The file is only trusted when it
+// was written for the same GPU (vendor, device, pipeline cache UUID) and the
+// same driver version; anything else starts an empty cache.
+class PipelineCache {
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& path);
+    // Saves the cache back to disk, then destroys it.
+    void destroy();
+
+    VkPipelineCache handle() const { return cache; }
+    // True when pipelines are being created from a cache loaded off disk.
+    bool warm() const { return loadedBytes > 0; }
+    size_t loadedSize() const { return loadedBytes; }
+
+private:
+    VkDevice                   device = VK_NULL_HANDLE;
+    VkPipelineCache            cache = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties props{};
+    std::string                path;
+    size_t                     loadedBytes = 0;
+};
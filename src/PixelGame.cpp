@@ -1,29 +1,263 @@
 #include "PixelGame.h"
 #include "BlockRegistry.h"
+#include "Profiler.h"
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
 
-PixelGame::PixelGame() : pool(std::thread::hardware_concurrency()) {
-    if (BlockRegistry::count() == 0) {
-        BlockRegistry::registerBlock("Air", false);   // id 0
-        BlockRegistry::registerBlock("Dirt", true);   // id 1
+static BlockDesc solidBlock(const std::string& name, const BlockFaceTextures& textures) {
+    BlockDesc desc;
+    desc.name = name;
+    desc.textures = textures;
+    return desc;
+}
+
+void PixelGame::registerBlocks() {
+    if (!BlockRegistry::frozen()) {
+        BlockDesc air;
+        air.name = "Air";
+        air.opaque = false;
+        air.transparency = 255;
+        air.collision = CollisionShape::None;
+        BlockRegistry::registerBlock(air);                                                 // id 0
+        BlockRegistry::registerBlock(solidBlock("Dirt", BlockRegistry::allFaces("dirt")));   // id 1
+        BlockRegistry::registerBlock(solidBlock("Grass",                                     // id 2
+            BlockRegistry::columnFaces("grass_top", "grass_side", "dirt")));
+        BlockRegistry::registerBlock(solidBlock("Stone", BlockRegistry::allFaces("stone"))); // id 3
+        BlockDesc water = solidBlock("Water", BlockRegistry::allFaces("water"));
+        water.opaque = false;
+        water.transparency = 200;
+        water.collision = CollisionShape::None;
+        water.renderLayer = RenderLayer::Translucent;
+        BlockRegistry::registerBlock(water);                                                 // id 4
+        BlockDesc glass = solidBlock("Glass", BlockRegistry::allFaces("glass"));
+        glass.opaque = false;
+        glass.transparency = 230;
+        glass.renderLayer = RenderLayer::Translucent;
+        BlockRegistry::registerBlock(glass);                                                 // id 5
+        BlockDesc leaves = solidBlock("Leaves", BlockRegistry::allFaces("leaves"));
+        leaves.opaque = false;
+        leaves.transparency = 96;
+        leaves.renderLayer = RenderLayer::Cutout;
+        BlockRegistry::registerBlock(leaves);                                                // id 6
+        // Workers only ever read the tables from here on.
+        BlockRegistry::freeze();
     }
 }
+
+PixelGame::PixelGame() : pool(std::thread::hardware_concurrency()) {
+    registerBlocks();
+    // Start above the terrain looking out over it.
+    player.position = glm::vec3(0.f, float(Chunk::GROUND_LEVEL * 2), 0.f);
+    player.pitch = -30.f;
+}
 PixelGame::~PixelGame() {}
 
-void PixelGame::loadWorld(std::vector<Vertex>& vertices,
-                          std::vector<uint32_t>& indices) {
-    chunks.emplace_back();
-    chunks.back().generateTestData();
-    greedyMesh(chunks.back(), vertices, indices);
-    std::cout << "Generated mesh with " << vertices.size() << " vertices\n";
+// Generates, decorates and meshes a square of chunks in parallel on the
+// thread pool. Structures may reach into neighbours, so every chunk is
+// generated and decorated before any is meshed. Must be called from outside
+// the pool, since it waits on its own tasks.
+void PixelGame::loadWorld() {
+    PROFILE_ZONE("PixelGame::loadWorld");
+    const int side = WORLD_RADIUS * 2;
+    world.clear();
+    structures.clear();
+    for (auto& handle : chunks) chunkPool.release(handle);
+    chunks.resize(side * side);
+    for (auto& handle : chunks) {
+        handle = chunkPool.acquire();
+        if (!handle.valid()) throw std::runtime_error("Chunk pool memory cap reached");
+    }
+    chunkMeshes.resize(chunks.size());
+    chunkConnectivity.resize(chunks.size());
+
+    // 1. Terrain and this chunk's structures. Pieces for neighbours wait for
+    // them, or are ready for the flush below if they were generated first.
+    std::vector<std::future<void>> jobs;
+    jobs.reserve(chunks.size());
+    ChunkMetrics& m = chunkMetrics;
+    m.loaded.add((int64_t)chunks.size());
+    m.queued.add((int64_t)chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        jobs.push_back(pool.enqueue([this, i, side, &m] {
+            Chunk& chunk = this->chunk(i);
+            m.queued.add(-1);
+            m.generating.add(1);
+            chunk.position = { (int)(i % side) - WORLD_RADIUS, 0, (int)(i / side) - WORLD_RADIUS };
+            chunk.generateTestData();
+            decorate(chunk);
+            structures.chunkGenerated(chunk);
+            m.generating.add(-1);
+            m.generated.add(1);
+        }));
+    }
+    for (auto& job : jobs) job.wait();
+    for (auto& handle : chunks) world.insert(handle);
+
+    // 2. Pieces that arrived after their chunk was generated.
+    structures.flush();
+
+    // 3. Meshes and connectivity.
+    jobs.clear();
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        jobs.push_back(pool.enqueue([this, i, &m] {
+            m.generated.add(-1);
+            m.meshing.add(1);
+            Chunk& chunk = this->chunk(i);
+            MeshData& mesh = chunkMeshes[i];
+            mesh = meshBuffers.acquire();
+            greedyMesh(chunk, mesh);
+            chunkConnectivity[i] = computeConnectivity(chunk);
+            m.meshing.add(-1);
+            m.vertices.add((int64_t)mesh.vertices.size());
+            m.quads.add((int64_t)mesh.vertices.size() / 4);
+        }));
+    }
+    size_t vertexCount = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        jobs[i].wait();
+        vertexCount += chunkMeshes[i].vertices.size();
+    }
+    std::cout << "Generated " << chunks.size() << " chunks with "
+              << vertexCount << " vertices\n";
+
+    std::vector<glm::ivec3> positions;
+    positions.reserve(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) positions.push_back(chunk(i).position);
+    visibilityGraph.build(positions, chunkConnectivity);
+}
+
+// Up to three bushes and boulders per chunk, sitting on the grass anywhere in
+// the chunk, so plenty of them straddle a chunk border.
+void PixelGame::decorate(const Chunk& chunk) {
+    uint32_t h = ((uint32_t)(chunk.position.x * 73856093) ^ (uint32_t)(chunk.position.z * 19349663)) | 1;
+    auto next = [&h] {
+        h ^= h << 13;
+        h ^= h >> 17;
+        h ^= h << 5;
+        return h;
+    };
+    const glm::ivec3 origin = World::origin(chunk.position);
+    const int count = (int)(next() % 4);
+    for (int i = 0; i < count; ++i) {
+        const auto& schematic = (next() & 1) ? bush : boulder;
+        const glm::ivec3 size = schematic->size();
+        glm::ivec3 corner(origin.x + (int)(next() % Chunk::SIZE_X) - size.x / 2,
+                          origin.y + Chunk::GROUND_LEVEL,
+                          origin.z + (int)(next() % Chunk::SIZE_Z) - size.z / 2);
+        structures.place(schematic, corner);
+    }
+}
+
+// The walk only depends on which chunk the camera is in, so it reruns when
+// the camera crosses a chunk boundary.
+void PixelGame::updateVisibility() {
+    glm::ivec3 current(glm::floor(player.position / glm::vec3(Chunk::dims())));
+    if (current == cameraChunk) return;
+    cameraChunk = current;
+    size_t visible = visibilityGraph.findVisible(cameraChunk, chunkVisible);
+    app.setChunkVisibility(chunkVisible);
+    std::cout << "Cave culling: " << visible << " of " << chunks.size() << " chunks visible\n";
+}
+
+// Meshes stay in chunk-local coordinates; the chunk origin goes with the draw.
+// uploadMesh copies the data into the staging ring, so the buffers go straight
+// back to the pool for the next remesh.
+void PixelGame::uploadWorld() {
+    for (size_t i = 0; i < chunkMeshes.size(); ++i) {
+        glm::vec3 origin = glm::vec3(chunk(i).position * Chunk::dims());
+        const MeshData& mesh = chunkMeshes[i];
+        app.uploadMesh(mesh.vertices, mesh.indices, origin,
+                       mesh.cutoutIndexCount, mesh.translucentIndexCount);
+        meshBuffers.release(std::move(chunkMeshes[i]));
+    }
+    chunkMetrics.uploading.add((int64_t)chunkMeshes.size());
+    app.logMeshMemoryStats();
+}
+
+// Logs every metric once per METRICS_INTERVAL and, with a metrics path set,
+// rewrites the scrape file.
+void PixelGame::tickMetrics(float dt) {
+    if (chunkMetrics.uploading.value() > 0 && app.uploadsComplete()) {
+        chunkMetrics.uploaded.add(chunkMetrics.uploading.value());
+        chunkMetrics.uploading.set(0);
+    }
+    metricsTimer += dt;
+    if (metricsTimer < METRICS_INTERVAL) return;
+    metricsTimer = 0.f;
+    std::cout << "Metrics: " << Metrics::summaryLine() << "\n";
+    if (!metricsPath.empty() && !Metrics::writePrometheusFile(metricsPath))
+        std::cerr << "Failed to write metrics " << metricsPath << "\n";
 }
 
 void PixelGame::run() {
     app.initWindow(800, 600, "PixelGame");
-    std::vector<Vertex> vertices; std::vector<uint32_t> indices;
-    pool.enqueue([this,&vertices,&indices](){ loadWorld(vertices, indices); }).wait();
-    app.initVulkan(vertices, indices);
-    app.setUpdateCallback([this](float dt){ player.update(app.getWindow(), dt); });
+    loadWorld();
+    app.setRecordPool(&pool);
+    app.initVulkan();
+    uploadWorld();
+    app.setUpdateCallback([this](float dt){
+        player.update(app.getWindow(), dt);
+        app.setCamera(player.getViewMatrix());
+        if (caveCulling) updateVisibility();
+        tickMetrics(dt);
+    });
     app.mainLoop();
     app.cleanup();
+    writeTrace();
+}
+
+void PixelGame::writeTrace() const {
+    if (tracePath.empty()) return;
+    if (!VOXEL_PROFILER)
+        std::cerr << "Profiler compiled out (VOXEL_PROFILER=0); the trace will be empty\n";
+    if (Profiler::writeChromeTrace(tracePath))
+        std::cout << "Trace written to " << tracePath << "\n";
+    else
+        std::cerr << "Failed to write trace " << tracePath << "\n";
+}
+
+void PixelGame::runBenchmark(const BenchmarkOptions& options) {
+    PROFILE_THREAD("Main");
+    app.setHeadless(options.width, options.height);
+    loadWorld();
+    app.setRecordPool(&pool);
+    app.initVulkan();
+    uploadWorld();
+    std::cout << "Benchmarking on " << app.deviceName() << " at "
+              << options.width << "x" << options.height << "\n";
+
+    CameraPath path = CameraPath::flyover(float(WORLD_RADIUS * Chunk::SIZE_X));
+    auto placeCamera = [this, &path](float t) {
+        CameraKeyframe key = path.sample(t);
+        player.position = key.position;
+        player.yaw = key.yaw;
+        player.pitch = key.pitch;
+        app.setCamera(player.getViewMatrix());
+        if (caveCulling) updateVisibility();
+    };
+
+    // Keep streaming and pipeline warm-up out of the recorded frames.
+    placeCamera(0.f);
+    while (!app.uploadsComplete()) app.renderFrame();
+    for (uint32_t i = 0; i < options.warmupFrames; i++) app.renderFrame();
+    app.finishFrames();
+    app.takeFrameStats();
+
+    app.setFrameStatsEnabled(true);
+    for (uint32_t i = 0; i < options.frames; i++) {
+        PROFILE_ZONE("Frame");
+        placeCamera(options.frames > 1 ? float(i) / float(options.frames - 1) : 0.f);
+        app.renderFrame();
+    }
+    app.finishFrames();
+    app.setFrameStatsEnabled(false);
+
+    std::vector<FrameStats> stats = app.takeFrameStats();
+    writeBenchmarkReport(options, app.deviceName(), stats);
+    std::cout << "Benchmark: " << summarizeBenchmark(stats) << "\n"
+              << "Report written to " << options.reportPath << "\n";
+    tickMetrics(METRICS_INTERVAL); // one final log line and scrape file
+    app.cleanup();
+    writeTrace();
 }
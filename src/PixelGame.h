@@ -2,8 +2,15 @@
 #include "VulkanApp.h"
 #include "ThreadPool.h"
 #include "Chunk.h"
+#include "ChunkPool.h"
+#include "World.h"
+#include "Schematic.h"
+#include "StructurePlacer.h"
 #include "Mesher.h"
 #include "PlayerController.h"
+#include "ChunkVisibility.h"
+#include "Benchmark.h"
+#include "Metrics.h"
 #include <vector>
 #include <thread>
 
@@ -12,11 +19,66 @@ public:
     PixelGame();
     ~PixelGame();
     void run();
+    // Renders options.frames frames offscreen along a scripted camera path and
+    // writes the per-frame stats to options.reportPath. Needs no display.
+    void runBenchmark(const BenchmarkOptions& options);
+    // Registers the game's blocks and freezes the registry (once per process).
+    static void registerBlocks();
+    // Draw chunks through compute-culled indirect draws (see VulkanApp::setGpuDriven).
+    void setGpuDriven(bool enabled) { app.setGpuDriven(enabled); }
+    // Hide chunks walled off from the camera by solid terrain (CPU only).
+    void setCaveCulling(bool enabled) { caveCulling = enabled; }
+    // Dump the profiler's zones as Chrome trace JSON when the game exits.
+    void setTracePath(const std::string& path) { tracePath = path; }
+    // Rewrite the metrics in Prometheus text format to this file every
+    // METRICS_INTERVAL seconds, next to the periodic log line.
+    void setMetricsPath(const std::string& path) { metricsPath = path; }
 private:
+    static constexpr int WORLD_RADIUS = 8; // chunks loaded around the origin in X/Z
+    static constexpr float METRICS_INTERVAL = 5.f; // seconds
+
+    // Chunks by where they are in the load pipeline, queued -> generating ->
+    // generated -> meshing -> uploading -> uploaded. Each chunk is counted in
+    // at most one state gauge at a time. The states only move during
+    // loadWorld() and uploadWorld(), apart from tickMetrics() noticing that
+    // uploads have become resident; nothing tracks chunks after that.
+    struct ChunkMetrics {
+        Gauge& loaded     = Metrics::gauge("chunks_loaded", "Chunks in the world");
+        Gauge& queued     = Metrics::gauge("chunks_queued", "Chunks waiting for a worker");
+        Gauge& generating = Metrics::gauge("chunks_generating", "Chunks being generated");
+        Gauge& generated  = Metrics::gauge("chunks_generated", "Generated chunks waiting to be meshed");
+        Gauge& meshing    = Metrics::gauge("chunks_meshing", "Chunks being meshed");
+        Gauge& uploading  = Metrics::gauge("chunks_uploading", "Meshed chunks not yet resident on the GPU");
+        Gauge& uploaded   = Metrics::gauge("chunks_uploaded", "Chunks drawable on the GPU");
+        Gauge& vertices   = Metrics::gauge("world_vertices", "Vertices in all chunk meshes");
+        Gauge& quads      = Metrics::gauge("world_quads", "Quads in all chunk meshes");
+    };
+
     VulkanApp app;
     ThreadPool pool;
     PlayerController player;
-    std::vector<Chunk> chunks;
-    void loadWorld(std::vector<Vertex>& vertices,
-                   std::vector<uint32_t>& indices);
+    ChunkPool chunkPool;
+    std::vector<ChunkHandle> chunks; // loaded chunks, in chunkMeshes order
+    World world{chunkPool};          // the same chunks by position, for world edits
+    StructurePlacer structures{world, pool};
+    std::shared_ptr<const Schematic> bush = std::make_shared<Schematic>(Schematic::bush(2));
+    std::shared_ptr<const Schematic> boulder = std::make_shared<Schematic>(Schematic::boulder(2));
+    std::vector<MeshData> chunkMeshes; // emptied back into meshBuffers once uploaded
+    MeshBufferPool meshBuffers;
+    std::vector<ChunkConnectivity> chunkConnectivity;
+    ChunkVisibilityGraph visibilityGraph;
+    std::vector<uint8_t> chunkVisible;
+    glm::ivec3 cameraChunk{INT32_MAX};
+    bool caveCulling = false;
+    std::string tracePath;
+    std::string metricsPath;
+    ChunkMetrics chunkMetrics;
+    float metricsTimer = 0.f;
+    void loadWorld();
+    void decorate(const Chunk& chunk);
+    Chunk& chunk(size_t i) const { return *chunkPool.get(chunks[i]); }
+    void uploadWorld();
+    void writeTrace() const;
+    void tickMetrics(float dt);
+    void updateVisibility();
 };
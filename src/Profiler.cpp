@@ -0,0 +1,143 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+enum class EventKind : uint8_t { Zone, Counter };
+
+// Fields are relaxed atomics so a dump racing a wrapping writer reads stale
+// values instead of invoking a data race; such events are discarded anyway.
+struct Event {
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint64_t>    start{ 0 };
+    std::atomic<uint64_t>    value{ 0 }; // end time for zones
+    std::atomic<EventKind>   kind{ EventKind::Zone };
+};
+
+struct ThreadRing {
+    std::unique_ptr<Event[]> events{ new Event[Profiler::RING_CAPACITY] };
+    std::atomic<uint64_t>    head{ 0 }; // events ever written; only the owner stores
+    uint32_t                 tid = 0;
+    std::string              name;      // guarded by ringsMutex
+};
+
+// Rings outlive their threads so pool workers that have exited still show up.
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<ThreadRing>> rings;
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+ThreadRing& threadRing() {
+    thread_local ThreadRing* ring = [] {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(std::make_unique<ThreadRing>());
+        rings.back()->tid = (uint32_t)rings.size();
+        return rings.back().get();
+    }();
+    return *ring;
+}
+
+void push(const char* name, uint64_t start, uint64_t value, EventKind kind) {
+    ThreadRing& ring = threadRing();
+    uint64_t h = ring.head.load(std::memory_order_relaxed);
+    // Seqlock-style: a dump that sees any of the stores below also sees head
+    // at least at h (stored by the previous push), so it knows the event at
+    // index h - RING_CAPACITY in this slot is being overwritten.
+    std::atomic_thread_fence(std::memory_order_release);
+    Event& e = ring.events[h % Profiler::RING_CAPACITY];
+    e.name.store(name, std::memory_order_relaxed);
+    e.start.store(start, std::memory_order_relaxed);
+    e.value.store(value, std::memory_order_relaxed);
+    e.kind.store(kind, std::memory_order_relaxed);
+    ring.head.store(h + 1, std::memory_order_release);
+}
+
+void writeJsonString(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') out << '\\';
+        if ((unsigned char)*s >= 0x20) out << *s;
+    }
+    out << '"';
+}
+
+} // namespace
+
+uint64_t Profiler::now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::recordZone(const char* name, uint64_t start, uint64_t end) {
+    push(name, start, end, EventKind::Zone);
+}
+
+void Profiler::recordCounter(const char* name, uint64_t value) {
+    push(name, now(), value, EventKind::Counter);
+}
+
+void Profiler::setThreadName(const char* name) {
+    ThreadRing& ring = threadRing();
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    ring.name = name;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    out << std::fixed << std::setprecision(3); // microseconds, to the nanosecond
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() -> std::ostream& {
+        if (!first) out << ",\n";
+        first = false;
+        return out;
+    };
+    for (auto& ring : rings) {
+        std::string name = ring->name.empty() ? "thread " + std::to_string(ring->tid) : ring->name;
+        separator() << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << ring->tid
+                    << ",\"args\":{\"name\":";
+        writeJsonString(out, name.c_str());
+        out << "}}";
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+        struct Copy { const char* name; uint64_t start, value; EventKind kind; };
+        std::vector<Copy> copies;
+        copies.reserve((size_t)(head - begin));
+        for (uint64_t i = begin; i < head; i++) {
+            const Event& e = ring->events[i % RING_CAPACITY];
+            copies.push_back({ e.name.load(std::memory_order_relaxed), e.start.load(std::memory_order_relaxed),
+                               e.value.load(std::memory_order_relaxed), e.kind.load(std::memory_order_relaxed) });
+        }
+        // The owner may have wrapped over the oldest slots while we copied,
+        // and may be writing the slot of index `after - RING_CAPACITY` now.
+        // The fence pairs with the one in push(): a field we read from an
+        // overwrite guarantees `after` covers that overwrite.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = ring->head.load(std::memory_order_relaxed);
+        uint64_t firstValid = after >= RING_CAPACITY ? after - RING_CAPACITY + 1 : 0;
+        for (uint64_t i = std::max(begin, firstValid); i < head; i++) {
+            const Copy& e = copies[(size_t)(i - begin)];
+            if (!e.name) continue;
+            separator() << "{\"name\":";
+            writeJsonString(out, e.name);
+            if (e.kind == EventKind::Zone)
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->tid << ",\"ts\":" << e.start / 1000.0
+                    << ",\"dur\":" << (e.value - e.start) / 1000.0 << "}";
+            else
+                out << ",\"ph\":\"C\",\"pid\":1,\"tid\":" << ring->tid << ",\"ts\":" << e.start / 1000.0
+                    << ",\"args\":{\"value\":" << e.value << "}}";
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Scoped-zone CPU profiler. Each thread appends finished zones to its own
+// fixed-size ring, so recording takes no locks and only the newest
+// RING_CAPACITY events per thread are kept. writeChromeTrace() dumps every
+// ring as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Build with VOXEL_PROFILER=0 to compile every PROFILE_* macro away.
+class Profiler {
+public:
+    static constexpr uint32_t RING_CAPACITY = 1u << 16; // events per thread
+
+    // Nanoseconds since the profiler's epoch (first use in the process).
+    static uint64_t now();
+    // `name` must outlive the profiler, in practice a string literal.
+    static void recordZone(const char* name, uint64_t start, uint64_t end);
+    static void recordCounter(const char* name, uint64_t value);
+    // Names the calling thread in the trace. Call before its first zone.
+    static void setThreadName(const char* name);
+
+    // Safe while other threads keep recording; events they overwrite during
+    // the dump are dropped rather than written torn. Returns false when the
+    // file can't be written.
+    static bool writeChromeTrace(const std::string& path);
+};
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* zoneName) : name(zoneName), start(Profiler::now()) {}
+    ~ProfileZone() { Profiler::recordZone(name, start, Profiler::now()); }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+private:
+    const char* name;
+    uint64_t    start;
+};
+
+#ifndef VOXEL_PROFILER
+#define VOXEL_PROFILER 1
+#endif
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if VOXEL_PROFILER
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::recordCounter(name, (uint64_t)(value))
+#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
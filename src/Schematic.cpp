@@ -0,0 +1,168 @@
+#include "Schematic.h"
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+// Every field is little-endian, whatever the host.
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint16_t sizeX, sizeY, sizeZ;
+    uint16_t paletteSize;
+    uint32_t runCount;
+};
+constexpr size_t   HEADER_BYTES = 20;
+constexpr uint32_t SCHEMATIC_MAGIC = 0x43535856; // "VXSC"
+constexpr uint32_t SCHEMATIC_VERSION = 2;        // 1 stored raw block ids in the palette
+constexpr int      MAX_SIZE = 4096;              // per axis
+// Each run is a little-endian uint16 length followed by a palette entry.
+constexpr size_t   RUN_BYTES = 3;
+constexpr size_t   MAX_RUN = 0xFFFF;
+
+void putLE(std::vector<uint8_t>& out, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(uint8_t(value >> (8 * i)));
+}
+
+uint32_t getLE(const uint8_t* in, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; ++i) value |= uint32_t(in[i]) << (8 * i);
+    return value;
+}
+}
+
+Schematic::Schematic(const glm::ivec3& size) : dims(size) {
+    if (size.x <= 0 || size.y <= 0 || size.z <= 0 || size.x > MAX_SIZE || size.y > MAX_SIZE || size.z > MAX_SIZE)
+        throw std::runtime_error("Failed to create schematic: invalid size");
+    voxels.assign(size_t(size.x) * size.y * size.z, 0);
+}
+
+// Header, then the palette, then the runs in voxel order. Palette entries
+// are block names (a length byte, then the bytes), so a saved schematic does
+// not depend on the order blocks were registered in.
+std::vector<uint8_t> Schematic::encode() const {
+    std::array<int, 256> entry;
+    entry.fill(-1);
+    std::vector<BlockRegistry::BlockID> palette;
+    std::vector<uint8_t> runs;
+    for (size_t i = 0; i < voxels.size();) {
+        size_t end = i;
+        while (end < voxels.size() && end - i < MAX_RUN && voxels[end] == voxels[i]) ++end;
+        if (entry[voxels[i]] < 0) {
+            entry[voxels[i]] = (int)palette.size();
+            palette.push_back(voxels[i]);
+        }
+        putLE(runs, uint32_t(end - i), 2);
+        runs.push_back(uint8_t(entry[voxels[i]]));
+        i = end;
+    }
+
+    std::vector<uint8_t> bytes;
+    putLE(bytes, SCHEMATIC_MAGIC, 4);
+    putLE(bytes, SCHEMATIC_VERSION, 4);
+    putLE(bytes, uint32_t(dims.x), 2);
+    putLE(bytes, uint32_t(dims.y), 2);
+    putLE(bytes, uint32_t(dims.z), 2);
+    putLE(bytes, uint32_t(palette.size()), 2);
+    putLE(bytes, uint32_t(runs.size() / RUN_BYTES), 4);
+    for (BlockRegistry::BlockID id : palette) {
+        if (id >= BlockRegistry::count())
+            throw std::runtime_error("Failed to encode schematic: unregistered block id " + std::to_string(id));
+        const std::string& name = BlockRegistry::name(id);
+        if (name.size() > 0xFF)
+            throw std::runtime_error("Failed to encode schematic: block name too long: " + name);
+        bytes.push_back(uint8_t(name.size()));
+        bytes.insert(bytes.end(), name.begin(), name.end());
+    }
+    bytes.insert(bytes.end(), runs.begin(), runs.end());
+    return bytes;
+}
+
+Schematic Schematic::decode(const std::vector<uint8_t>& bytes) {
+    if (bytes.size() < HEADER_BYTES)
+        throw std::runtime_error("Failed to decode schematic: truncated header");
+    FileHeader h;
+    h.magic = getLE(&bytes[0], 4);
+    h.version = getLE(&bytes[4], 4);
+    h.sizeX = uint16_t(getLE(&bytes[8], 2));
+    h.sizeY = uint16_t(getLE(&bytes[10], 2));
+    h.sizeZ = uint16_t(getLE(&bytes[12], 2));
+    h.paletteSize = uint16_t(getLE(&bytes[14], 2));
+    h.runCount = getLE(&bytes[16], 4);
+    if (h.magic != SCHEMATIC_MAGIC || h.version != SCHEMATIC_VERSION)
+        throw std::runtime_error("Failed to decode schematic: not a version 2 schematic");
+
+    // Names back to this build's block ids.
+    std::vector<BlockRegistry::BlockID> palette(h.paletteSize);
+    size_t at = HEADER_BYTES;
+    for (auto& id : palette) {
+        if (at >= bytes.size() || bytes[at] > bytes.size() - at - 1)
+            throw std::runtime_error("Failed to decode schematic: truncated palette");
+        const std::string name(bytes.begin() + at + 1, bytes.begin() + at + 1 + bytes[at]);
+        if (!BlockRegistry::find(name, id))
+            throw std::runtime_error("Failed to decode schematic: unknown block " + name);
+        at += 1 + name.size();
+    }
+    if (bytes.size() - at != size_t(h.runCount) * RUN_BYTES)
+        throw std::runtime_error("Failed to decode schematic: size does not match header");
+
+    // The header is untrusted: check that the runs can cover the volume
+    // before allocating it.
+    const size_t volume = size_t(h.sizeX) * h.sizeY * h.sizeZ;
+    if (volume == 0 || volume > size_t(h.runCount) * MAX_RUN)
+        throw std::runtime_error("Failed to decode schematic: size does not match the runs");
+
+    Schematic s(glm::ivec3(h.sizeX, h.sizeY, h.sizeZ));
+    const uint8_t* run = bytes.data() + at;
+    size_t filled = 0;
+    for (uint32_t r = 0; r < h.runCount; ++r, run += RUN_BYTES) {
+        size_t length = getLE(run, 2);
+        if (run[2] >= h.paletteSize || length > s.voxels.size() - filled)
+            throw std::runtime_error("Failed to decode schematic: bad run");
+        std::memset(s.voxels.data() + filled, palette[run[2]], length);
+        filled += length;
+    }
+    if (filled != s.voxels.size())
+        throw std::runtime_error("Failed to decode schematic: runs do not cover the volume");
+    return s;
+}
+
+void Schematic::save(const std::string& path) const {
+    std::vector<uint8_t> bytes = encode();
+    std::ofstream out(path, std::ios::binary);
+    if (!out.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size()))
+        throw std::runtime_error("Failed to write schematic " + path);
+}
+
+Schematic Schematic::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Failed to open schematic " + path);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return decode(bytes);
+}
+
+Schematic Schematic::bush(int radius) {
+    const int w = 2 * radius + 1;
+    Schematic s(glm::ivec3(w, radius + 1, w));
+    for (int z = 0; z < w; ++z)
+        for (int y = 0; y <= radius; ++y)
+            for (int x = 0; x < w; ++x) {
+                int dx = x - radius, dz = z - radius;
+                if (dx * dx + y * y + dz * dz <= radius * radius + radius) s.set(x, y, z, 6);
+            }
+    return s;
+}
+
+Schematic Schematic::boulder(int radius) {
+    const int w = 2 * radius + 1;
+    Schematic s(glm::ivec3(w, radius + 1, w));
+    for (int z = 0; z < w; ++z)
+        for (int y = 0; y <= radius; ++y)
+            for (int x = 0; x < w; ++x) {
+                int dx = x - radius, dy = 2 * y - radius, dz = z - radius;
+                if (dx * dx + dy * dy + dz * dz <= radius * radius) s.set(x, y, z, 3);
+            }
+    return s;
+}
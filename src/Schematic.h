@@ -0,0 +1,42 @@
+#pragma once
+#include "BlockRegistry.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// A prefab structure (tree, building, ore vein): a box of block ids placed by
+// its first corner. Air in a schematic is "leave the world alone", so a
+// structure only replaces the voxels it actually has.
+//
+// In memory the voxels are dense (X fastest, then Y, then Z) so placing one
+// is a row copy per chunk it touches. Serialised, they are a palette of the
+// names of the blocks used plus runs of palette entries; see encode().
+class Schematic {
+public:
+    Schematic() = default;
+    // All air.
+    explicit Schematic(const glm::ivec3& size);
+
+    glm::ivec3 size() const { return dims; }
+    BlockRegistry::BlockID get(int x, int y, int z) const { return voxels[index(x, y, z)]; }
+    void set(int x, int y, int z, BlockRegistry::BlockID type) { voxels[index(x, y, z)] = type; }
+    const BlockRegistry::BlockID* data() const { return voxels.data(); }
+
+    // Throws std::runtime_error on malformed data or a block name the
+    // registry does not know.
+    std::vector<uint8_t> encode() const;
+    static Schematic decode(const std::vector<uint8_t>& bytes);
+    void save(const std::string& path) const;
+    static Schematic load(const std::string& path);
+
+    // Built-in decorations for the test terrain, made of PixelGame's blocks.
+    static Schematic bush(int radius);    // a dome of leaves, 2*radius+1 wide
+    static Schematic boulder(int radius); // a squashed ball of stone
+
+private:
+    glm::ivec3                          dims{0};
+    std::vector<BlockRegistry::BlockID> voxels;
+
+    size_t index(int x, int y, int z) const { return size_t(x) + size_t(y) * dims.x + size_t(z) * dims.x * dims.y; }
+};
@@ -0,0 +1,91 @@
+#include "StructurePlacer.h"
+#include "Profiler.h"
+#include <future>
+
+void StructurePlacer::place(std::shared_ptr<const Schematic> schematic, const glm::ivec3& origin) {
+    const glm::ivec3 first = World::chunkOf(origin);
+    const glm::ivec3 last = World::chunkOf(origin + schematic->size() - glm::ivec3(1));
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int z = first.z; z <= last.z; ++z)
+        for (int y = first.y; y <= last.y; ++y)
+            for (int x = first.x; x <= last.x; ++x) {
+                const glm::ivec3 position(x, y, z);
+                const uint64_t key = World::key(position);
+                const bool isGenerated = generated.count(key) != 0;
+                ChunkPieces& entry = isGenerated ? ready[key] : waiting[key];
+                entry.position = position;
+                entry.pieces.push_back({ schematic, origin });
+                if (!isGenerated) {
+                    waitingCount++;
+                    waitingGauge.add(1);
+                }
+            }
+}
+
+// The chunk only counts as generated once no piece is left waiting for it.
+// Until then place() keeps queueing here, so pieces placed while this thread
+// pastes are applied by it too, in order, and flush() never sees the chunk.
+void StructurePlacer::chunkGenerated(Chunk& chunk) {
+    const uint64_t key = World::key(chunk.position);
+    for (;;) {
+        std::vector<Piece> pieces;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = waiting.find(key);
+            if (it == waiting.end()) {
+                generated.insert(key);
+                return;
+            }
+            pieces = std::move(it->second.pieces);
+            waiting.erase(it);
+            waitingCount -= pieces.size();
+            waitingGauge.add(-(int64_t)pieces.size());
+        }
+        apply(chunk, pieces);
+        applied.add(pieces.size());
+    }
+}
+
+std::vector<glm::ivec3> StructurePlacer::flush() {
+    PROFILE_ZONE("StructurePlacer::flush");
+    std::unordered_map<uint64_t, ChunkPieces> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(ready);
+    }
+    std::vector<glm::ivec3> changed;
+    std::vector<std::future<void>> jobs;
+    jobs.reserve(batch.size());
+    for (auto& entry : batch) {
+        Chunk* chunk = world.find(entry.second.position);
+        if (!chunk) continue; // generated, then unloaded before its pieces came due
+        changed.push_back(entry.second.position);
+        const std::vector<Piece>& pieces = entry.second.pieces;
+        jobs.push_back(pool.enqueue([chunk, &pieces] { apply(*chunk, pieces); }));
+        applied.add(pieces.size());
+    }
+    for (auto& job : jobs) job.wait();
+    return changed;
+}
+
+void StructurePlacer::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    generated.clear();
+    waiting.clear();
+    ready.clear();
+    waitingGauge.add(-(int64_t)waitingCount);
+    waitingCount = 0;
+}
+
+size_t StructurePlacer::waitingPieces() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return waitingCount;
+}
+
+// Pieces land in the order they were placed, so later structures win.
+void StructurePlacer::apply(Chunk& chunk, const std::vector<Piece>& pieces) {
+    PROFILE_ZONE("StructurePlacer::apply");
+    const glm::ivec3 origin = World::origin(chunk.position);
+    for (const Piece& piece : pieces)
+        chunk.paste(piece.schematic->data(), piece.schematic->size(), piece.origin - origin);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "Metrics.h"
+#include "Schematic.h"
+#include "ThreadPool.h"
+#include "World.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Places schematics that may span many chunks. A placement is split into one
+// piece per chunk it overlaps, and each piece goes one of two ways:
+//
+//  - its chunk is not generated yet: the piece waits, and chunkGenerated()
+//    applies it on the generating thread right after the terrain is made,
+//    together with any piece placed while that thread is still pasting;
+//  - its chunk is generated: the piece is ready, and flush() applies all
+//    ready pieces on the thread pool, one task per chunk.
+//
+// Either way only one thread works on a chunk at a time, so pieces need no
+// lock on the world and decoration spreads over every worker. The lock here
+// only guards the piece lists.
+class StructurePlacer {
+public:
+    StructurePlacer(World& world, ThreadPool& pool) : world(world), pool(pool) {}
+
+    // Queues the schematic with its first corner at origin (world voxels).
+    // Thread-safe.
+    void place(std::shared_ptr<const Schematic> schematic, const glm::ivec3& origin);
+    // Call from the task that generated chunk, once its terrain is done:
+    // marks it generated and applies the pieces that waited for it.
+    void chunkGenerated(Chunk& chunk);
+    // Applies every ready piece whose chunk is in the world, in parallel, and
+    // returns the positions of the chunks it changed. Waits on the pool, so
+    // it must be called from outside it.
+    std::vector<glm::ivec3> flush();
+    // Forgets generated chunks and every queued piece, for a world reload.
+    void clear();
+    size_t waitingPieces() const;
+
+private:
+    struct Piece {
+        std::shared_ptr<const Schematic> schematic;
+        glm::ivec3                       origin; // world voxels
+    };
+    struct ChunkPieces {
+        glm::ivec3         position{0};
+        std::vector<Piece> pieces;
+    };
+
+    World&                                    world;
+    ThreadPool&                               pool;
+    mutable std::mutex                        mutex;
+    std::unordered_set<uint64_t>              generated; // by World::key
+    std::unordered_map<uint64_t, ChunkPieces> waiting;   // chunk not generated yet
+    std::unordered_map<uint64_t, ChunkPieces> ready;     // chunk generated, piece not applied
+    size_t                                    waitingCount = 0;
+    Gauge&   waitingGauge = Metrics::gauge("structure_pieces_waiting", "Structure pieces waiting for their chunk to be generated");
+    Counter& applied = Metrics::counter("structure_pieces_applied_total", "Structure pieces stamped into chunks");
+
+    static void apply(Chunk& chunk, const std::vector<Piece>& pieces);
+};
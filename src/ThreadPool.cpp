@@ -1,17 +1,26 @@
 #include "ThreadPool.h"
+#include "Profiler.h"
 
-ThreadPool::ThreadPool(size_t threads) : stop(false) {
+ThreadPool::ThreadPool(size_t threads)
+    : stop(false),
+      queueDepth(Metrics::gauge("threadpool_queue_depth", "Tasks waiting for a ThreadPool worker")) {
     for (size_t i = 0; i < threads; ++i) {
         workers.emplace_back([this] {
+            PROFILE_THREAD("ThreadPool worker");
             for (;;) {
                 std::function<void()> task;
                 {
+                    // Time spent here is time the worker had nothing to run.
+                    PROFILE_ZONE("ThreadPool::wait");
                     std::unique_lock<std::mutex> lock(queue_mutex);
                     condition.wait(lock, [this]{ return stop || !tasks.empty(); });
                     if (stop && tasks.empty()) return;
                     task = std::move(tasks.front());
                     tasks.pop();
+                    queueDepth.add(-1);
+                    PROFILE_COUNTER("ThreadPool queue depth", tasks.size());
                 }
+                PROFILE_ZONE("ThreadPool::run");
                 task();
             }
         });
@@ -6,6 +6,7 @@
 #include <functional>
 #include <mutex>
 #include <condition_variable>
+#include "Metrics.h"
 
 class ThreadPool {
 public:
@@ -15,6 +16,8 @@ public:
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::invoke_result<F, Args...>::type>;
+
+    size_t size() const { return workers.size(); }
 private:
     std::vector<std::thread> workers;
     std::queue<std::function<void()>> tasks;
@@ -22,6 +25,7 @@ private:
     std::mutex queue_mutex;
     std::condition_variable condition;
     bool stop;
+    Gauge& queueDepth; // tasks waiting, summed over every pool
 };
 
 #include "ThreadPool.tpp"
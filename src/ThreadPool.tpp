@@ -15,6 +15,7 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
         std::unique_lock<std::mutex> lock(queue_mutex);
         tasks.emplace([task]() { (*task)(); });
     }
+    queueDepth.add(1);
     condition.notify_one();
     return res;
 }
@@ -0,0 +1,326 @@
+#include "UploadQueue.h"
+#include "GpuAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+// Keeps every staging range aligned for vertex/index copies.
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+void UploadQueue::init(VkDevice dev, VkPhysicalDevice physicalDevice,
+                       VkQueue q, uint32_t queueFamilyIndex,
+                       uint32_t graphicsQueueFamilyIndex, VkDeviceSize size) {
+    device = dev;
+    queue = q;
+    queueFamily = queueFamilyIndex;
+    graphicsFamily = graphicsQueueFamilyIndex;
+    asyncMode = queueFamily != graphicsFamily;
+    ringSize = size;
+
+    VkBufferCreateInfo bi{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bi.size = ringSize;
+    bi.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bi.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bi, nullptr, &ringBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create staging ring buffer");
+    VkMemoryRequirements memReq;
+    vkGetBufferMemoryRequirements(device, ringBuffer, &memReq);
+    VkMemoryAllocateInfo mai{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    mai.allocationSize = memReq.size;
+    mai.memoryTypeIndex = findMemoryType(physicalDevice, memReq.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (vkAllocateMemory(device, &mai, nullptr, &ringMemory) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate staging ring memory");
+    vkBindBufferMemory(device, ringBuffer, ringMemory, 0);
+    void* mapped;
+    if (vkMapMemory(device, ringMemory, 0, ringSize, 0, &mapped) != VK_SUCCESS)
+        throw std::runtime_error("Failed to map staging ring");
+    ringData = static_cast<uint8_t*>(mapped);
+
+    VkCommandPoolCreateInfo cpci{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    cpci.queueFamilyIndex = queueFamily;
+    cpci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    if (vkCreateCommandPool(device, &cpci, nullptr, &commandPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create upload command pool");
+
+    if (asyncMode) worker = std::thread([this] { workerLoop(); });
+}
+
+// The device must be idle and every semaphore handed out by acquire()
+// returned through recycleSemaphores().
+void UploadQueue::destroy() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workReady.notify_one();
+        worker.join();
+    }
+    while (!inFlight.empty()) retire(true);
+    for (auto& b : freeBatches) vkDestroyFence(device, b.fence, nullptr);
+    freeBatches.clear();
+    for (auto& h : handoffs) vkDestroySemaphore(device, h.semaphore, nullptr);
+    handoffs.clear();
+    for (auto sem : freeSemaphores) vkDestroySemaphore(device, sem, nullptr);
+    freeSemaphores.clear();
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkUnmapMemory(device, ringMemory);
+    vkDestroyBuffer(device, ringBuffer, nullptr);
+    vkFreeMemory(device, ringMemory, nullptr);
+}
+
+// Returns the ring offset of a contiguous range, skipping the tail end of the
+// ring when the range would wrap. Called with the lock held.
+VkDeviceSize UploadQueue::reserve(std::unique_lock<std::mutex>& lock, VkDeviceSize size) {
+    size = (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    if (size > ringSize)
+        throw std::runtime_error("Upload larger than the staging ring");
+    for (;;) {
+        VkDeviceSize pos = ringHead % ringSize;
+        VkDeviceSize skip = (pos + size > ringSize) ? ringSize - pos : 0;
+        if (ringHead + skip + size - ringTail <= ringSize) {
+            ringHead += skip;
+            VkDeviceSize offset = ringHead % ringSize;
+            ringHead += size;
+            return offset;
+        }
+        // Full: hand what we have to the GPU and wait for the oldest batch.
+        if (asyncMode) {
+            flushRequested = true;
+            workReady.notify_one();
+            spaceFreed.wait(lock);
+            continue;
+        }
+        lock.unlock();
+        if (inFlight.empty()) flush();
+        if (inFlight.empty())
+            throw std::runtime_error("Staging ring exhausted by a single batch");
+        retire(true);
+        lock.lock();
+    }
+}
+
+uint64_t UploadQueue::enqueue(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (size == 0) return nextTicket;
+    VkDeviceSize offset = reserve(lock, size);
+    memcpy(ringData + offset, data, (size_t)size);
+    pending.push_back({ dst, { offset, dstOffset, size } });
+    return nextTicket;
+}
+
+void UploadQueue::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pending.empty()) return;
+    if (asyncMode) {
+        flushRequested = true;
+        workReady.notify_one();
+        return;
+    }
+    std::vector<PendingCopy> copies;
+    copies.swap(pending);
+    uint64_t ticket = nextTicket++;
+    VkDeviceSize ringEnd = ringHead;
+    lock.unlock();
+    submit(copies, ringEnd, VK_NULL_HANDLE);
+    lock.lock();
+    submittedTicket = ticket;
+}
+
+uint64_t UploadQueue::lastTicket() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.empty() ? nextTicket - 1 : nextTicket;
+}
+
+VkDeviceSize UploadQueue::bytesInFlight() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ringHead - ringTail;
+}
+
+uint64_t UploadQueue::acquire(VkCommandBuffer cb, std::vector<VkSemaphore>& waitSemaphores) {
+    std::vector<Handoff> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!asyncMode) return submittedTicket;
+        ready.swap(handoffs);
+    }
+    if (ready.empty()) return submittedTicket;
+
+    std::vector<VkBufferMemoryBarrier> barriers;
+    for (auto& h : ready) {
+        for (auto& c : h.copies) {
+            VkBufferMemoryBarrier b{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+            b.srcAccessMask = 0;
+            b.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                VK_ACCESS_TRANSFER_READ_BIT;
+            b.srcQueueFamilyIndex = queueFamily;
+            b.dstQueueFamilyIndex = graphicsFamily;
+            b.buffer = c.dst;
+            b.offset = c.region.dstOffset;
+            b.size = c.region.size;
+            barriers.push_back(b);
+        }
+        waitSemaphores.push_back(h.semaphore);
+        submittedTicket = std::max(submittedTicket, h.ticket);
+    }
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, (uint32_t)barriers.size(), barriers.data(), 0, nullptr);
+    return submittedTicket;
+}
+
+void UploadQueue::recycleSemaphores(std::vector<VkSemaphore>& semaphores) {
+    if (semaphores.empty()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    freeSemaphores.insert(freeSemaphores.end(), semaphores.begin(), semaphores.end());
+    semaphores.clear();
+}
+
+UploadQueue::Batch UploadQueue::acquireBatch() {
+    retire(false);
+    if (!freeBatches.empty()) {
+        Batch b = freeBatches.back();
+        freeBatches.pop_back();
+        return b;
+    }
+    Batch b;
+    VkCommandBufferAllocateInfo ai{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    ai.commandPool = commandPool;
+    ai.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &ai, &b.cb) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate upload command buffer");
+    VkFenceCreateInfo fi{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    if (vkCreateFence(device, &fi, nullptr, &b.fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create upload fence");
+    return b;
+}
+
+// Called with the lock held.
+VkSemaphore UploadQueue::acquireSemaphore() {
+    if (!freeSemaphores.empty()) {
+        VkSemaphore sem = freeSemaphores.back();
+        freeSemaphores.pop_back();
+        return sem;
+    }
+    VkSemaphoreCreateInfo si{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    VkSemaphore sem;
+    if (vkCreateSemaphore(device, &si, nullptr, &sem) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create upload semaphore");
+    return sem;
+}
+
+void UploadQueue::submit(std::vector<PendingCopy>& copies, VkDeviceSize ringEnd, VkSemaphore signal) {
+    Batch batch = acquireBatch();
+    batch.ringEnd = ringEnd;
+
+    vkResetCommandBuffer(batch.cb, 0);
+    VkCommandBufferBeginInfo bi{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.cb, &bi);
+
+    // One vkCmdCopyBuffer per destination buffer.
+    std::stable_sort(copies.begin(), copies.end(),
+        [](const PendingCopy& a, const PendingCopy& b) { return a.dst < b.dst; });
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < copies.size();) {
+        VkBuffer dst = copies[i].dst;
+        regions.clear();
+        for (; i < copies.size() && copies[i].dst == dst; i++)
+            regions.push_back(copies[i].region);
+        vkCmdCopyBuffer(batch.cb, ringBuffer, dst, (uint32_t)regions.size(), regions.data());
+    }
+
+    if (asyncMode) {
+        // Release each range to the graphics family; acquire() records the
+        // matching half on the graphics queue.
+        std::vector<VkBufferMemoryBarrier> barriers;
+        barriers.reserve(copies.size());
+        for (auto& c : copies) {
+            VkBufferMemoryBarrier b{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+            b.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            b.dstAccessMask = 0;
+            b.srcQueueFamilyIndex = queueFamily;
+            b.dstQueueFamilyIndex = graphicsFamily;
+            b.buffer = c.dst;
+            b.offset = c.region.dstOffset;
+            b.size = c.region.size;
+            barriers.push_back(b);
+        }
+        vkCmdPipelineBarrier(batch.cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, (uint32_t)barriers.size(), barriers.data(), 0, nullptr);
+    }
+    else {
+        // Later submissions on this queue read the data as vertices/indices,
+        // or copy it again when the mesh pools are defragmented.
+        VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+            VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(batch.cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    vkEndCommandBuffer(batch.cb);
+
+    VkSubmitInfo si{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    si.commandBufferCount = 1;
+    si.pCommandBuffers = &batch.cb;
+    si.signalSemaphoreCount = signal != VK_NULL_HANDLE ? 1 : 0;
+    si.pSignalSemaphores = &signal;
+    if (vkQueueSubmit(queue, 1, &si, batch.fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit upload batch");
+    inFlight.push_back(batch);
+}
+
+// Recycles finished batches; with `wait`, blocks on the oldest one first.
+bool UploadQueue::retire(bool wait) {
+    if (wait && !inFlight.empty())
+        vkWaitForFences(device, 1, &inFlight.front().fence, VK_TRUE, UINT64_MAX);
+    VkDeviceSize tail = 0;
+    bool retired = false;
+    while (!inFlight.empty() && vkGetFenceStatus(device, inFlight.front().fence) == VK_SUCCESS) {
+        Batch b = inFlight.front();
+        inFlight.pop_front();
+        tail = b.ringEnd;
+        vkResetFences(device, 1, &b.fence);
+        freeBatches.push_back(b);
+        retired = true;
+    }
+    if (retired) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ringTail = tail;
+        }
+        spaceFreed.notify_all();
+    }
+    return retired;
+}
+
+void UploadQueue::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (!(flushRequested && !pending.empty())) {
+            // Poll in-flight batches so producers waiting for ring space wake up.
+            if (inFlight.empty()) workReady.wait(lock);
+            else workReady.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        if (flushRequested && !pending.empty()) {
+            std::vector<PendingCopy> copies;
+            copies.swap(pending);
+            uint64_t ticket = nextTicket++;
+            VkDeviceSize ringEnd = ringHead;
+            VkSemaphore signal = acquireSemaphore();
+            flushRequested = false;
+            lock.unlock();
+            submit(copies, ringEnd, signal);
+            lock.lock();
+            handoffs.push_back({ ticket, signal, std::move(copies) });
+        }
+        lock.unlock();
+        retire(false);
+        lock.lock();
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Streams buffer data into device-local memory through one persistently
+// mapped staging ring. Copies queued between flushes are recorded into a
+// single command buffer whose fence tells us when its slice of the ring can be
+// reused, so uploads never idle a queue.
+//
+// With a dedicated transfer queue family, batches are recorded and submitted
+// by a background thread. Each one releases its destination ranges to the
+// graphics family and signals a semaphore. acquire() then records the
+// matching acquire barriers into a frame's command buffer and hands back the
+// semaphores that frame must wait on. Without one, flush() submits on the
+// graphics queue directly and data is usable by the next submission.
+//
+// Every enqueue returns a ticket. Once acquire() has returned a ticket >= it,
+// commands recorded after the acquire may read the data.
+class UploadQueue {
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice,
+              VkQueue queue, uint32_t queueFamilyIndex,
+              uint32_t graphicsQueueFamilyIndex, VkDeviceSize ringSize);
+    void destroy();
+
+    // Copies `size` bytes into the ring and queues a transfer to dst+dstOffset.
+    // Blocks only when the ring is full. Thread-safe with a dedicated queue;
+    // otherwise a full ring submits on the graphics queue from the calling
+    // thread, so only the thread that submits frames may call it.
+    uint64_t enqueue(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset);
+    // Submits everything queued so far as one batch without waiting for it.
+    // Without a dedicated queue, same threading rule as enqueue().
+    void flush();
+    // Graphics side, called while recording a frame outside any render pass.
+    uint64_t acquire(VkCommandBuffer cb, std::vector<VkSemaphore>& waitSemaphores);
+    // Returns semaphores from acquire() once the frame that waited on them is done.
+    void recycleSemaphores(std::vector<VkSemaphore>& semaphores);
+
+    bool dedicated() const { return asyncMode; }
+    uint64_t lastTicket() const;
+    VkDeviceSize bytesInFlight() const;
+
+private:
+    struct Batch {
+        VkCommandBuffer cb = VK_NULL_HANDLE;
+        VkFence         fence = VK_NULL_HANDLE;
+        VkDeviceSize    ringEnd = 0; // ring position released when the fence signals
+    };
+    struct PendingCopy {
+        VkBuffer     dst;
+        VkBufferCopy region;
+    };
+    // A submitted batch whose ranges still have to be acquired by graphics.
+    struct Handoff {
+        uint64_t                 ticket = 0;
+        VkSemaphore              semaphore = VK_NULL_HANDLE;
+        std::vector<PendingCopy> copies;
+    };
+
+    VkDevice       device = VK_NULL_HANDLE;
+    VkQueue        queue = VK_NULL_HANDLE;
+    uint32_t       queueFamily = 0;
+    uint32_t       graphicsFamily = 0;
+    bool           asyncMode = false;
+    VkCommandPool  commandPool = VK_NULL_HANDLE; // only used by the submitting thread
+
+    VkBuffer       ringBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory ringMemory = VK_NULL_HANDLE;
+    uint8_t*       ringData = nullptr;
+    VkDeviceSize   ringSize = 0;
+    // Monotonic byte counters; position in the ring is counter % ringSize.
+    VkDeviceSize   ringHead = 0;
+    VkDeviceSize   ringTail = 0;
+
+    // Guarded by mutex.
+    mutable std::mutex       mutex;
+    std::condition_variable  workReady;  // worker: flush requested or stopping
+    std::condition_variable  spaceFreed; // producers: ring space released
+    std::vector<PendingCopy> pending;
+    uint64_t                 nextTicket = 1;
+    uint64_t                 submittedTicket = 0;
+    bool                     flushRequested = false;
+    bool                     stopping = false;
+    std::vector<Handoff>     handoffs;
+    std::vector<VkSemaphore> freeSemaphores;
+
+    // Owned by the submitting thread: the worker, or the frame thread when
+    // uploads share the graphics queue.
+    std::deque<Batch>  inFlight;
+    std::vector<Batch> freeBatches;
+    std::thread        worker;
+
+    VkDeviceSize reserve(std::unique_lock<std::mutex>& lock, VkDeviceSize size);
+    void submit(std::vector<PendingCopy>& copies, VkDeviceSize ringEnd, VkSemaphore signal);
+    bool retire(bool wait);
+    void workerLoop();
+    Batch acquireBatch();
+    VkSemaphore acquireSemaphore();
+};
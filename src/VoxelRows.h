@@ -0,0 +1,98 @@
+#pragma once
+#include "BlockRegistry.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOXEL_ROWS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Kernels over a contiguous run of block ids: one chunk row, or several whole
+// rows back to back. They use AVX2 when the compiler targets it (see
+// VOXEL_NATIVE_ARCH in CMake), SSE2 on any other x86-64 build and plain loops
+// elsewhere. Fill and copy are memset/memmove, which the C library already
+// vectorises; replace, paste and count are the ones compilers don't.
+
+inline void fillVoxelRow(BlockRegistry::BlockID* row, size_t n, BlockRegistry::BlockID type) {
+    std::memset(row, type, n);
+}
+
+// Source and destination may overlap.
+inline void copyVoxelRow(BlockRegistry::BlockID* dst, const BlockRegistry::BlockID* src, size_t n) {
+    std::memmove(dst, src, n);
+}
+
+inline void replaceVoxelRow(BlockRegistry::BlockID* row, size_t n, BlockRegistry::BlockID from, BlockRegistry::BlockID to) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i f = _mm256_set1_epi8((char)from), t = _mm256_set1_epi8((char)to);
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(row + i));
+        _mm256_storeu_si256((__m256i*)(row + i), _mm256_blendv_epi8(v, t, _mm256_cmpeq_epi8(v, f)));
+    }
+#elif defined(VOXEL_ROWS_SSE2)
+    const __m128i f = _mm_set1_epi8((char)from), t = _mm_set1_epi8((char)to);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i hit = _mm_cmpeq_epi8(v, f);
+        _mm_storeu_si128((__m128i*)(row + i), _mm_or_si128(_mm_and_si128(hit, t), _mm_andnot_si128(hit, v)));
+    }
+#endif
+    for (; i < n; i++)
+        if (row[i] == from) row[i] = to;
+}
+
+// Copies the non-air voxels of src over dst, leaving dst where src is air.
+inline void pasteVoxelRow(BlockRegistry::BlockID* dst, const BlockRegistry::BlockID* src, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i air = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_blendv_epi8(s, d, _mm256_cmpeq_epi8(s, air)));
+    }
+#elif defined(VOXEL_ROWS_SSE2)
+    const __m128i air = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i keep = _mm_cmpeq_epi8(s, air);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s)));
+    }
+#endif
+    for (; i < n; i++)
+        if (src[i] != 0) dst[i] = src[i];
+}
+
+// Matches are tallied in per-byte counters (a compare yields -1, so
+// subtracting it adds one) and summed with sad every 255 vectors, before
+// any counter can wrap.
+inline size_t countVoxelRow(const BlockRegistry::BlockID* row, size_t n, BlockRegistry::BlockID type) {
+    size_t total = 0, i = 0;
+#if defined(__AVX2__)
+    const __m256i k = _mm256_set1_epi8((char)type);
+    while (i + 32 <= n) {
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t end = i + 32 * (n - i >= 255 * 32 ? 255 : (n - i) / 32); i < end; i += 32)
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(row + i)), k));
+        alignas(32) uint64_t sums[4];
+        _mm256_store_si256((__m256i*)sums, _mm256_sad_epu8(acc, _mm256_setzero_si256()));
+        total += size_t(sums[0] + sums[1] + sums[2] + sums[3]);
+    }
+#elif defined(VOXEL_ROWS_SSE2)
+    const __m128i k = _mm_set1_epi8((char)type);
+    while (i + 16 <= n) {
+        __m128i acc = _mm_setzero_si128();
+        for (size_t end = i + 16 * (n - i >= 255 * 16 ? 255 : (n - i) / 16); i < end; i += 16)
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(row + i)), k));
+        __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+        total += size_t(_mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4));
+    }
+#endif
+    for (; i < n; i++) total += row[i] == type;
+    return total;
+}
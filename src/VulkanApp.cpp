@@ -3,13 +3,25 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include "VulkanApp.h"
+#include "ThreadPool.h"
+#include "BlockRegistry.h"
+#include "BlockTextures.h"
+#include "Profiler.h"
+#include "Metrics.h"
 #include <stdexcept>
 #include <iostream>
 #include <vector>
 #include <set>
 #include <fstream>
+#include <cstdio>
 #include <cstring>
 #include <string>   // for std::string in readFile
+#include <future>
+#include <algorithm>
+#include <map>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
 
 
 // Shader helpers
@@ -37,6 +49,7 @@ VkShaderModule VulkanApp::createShaderModule(VkDevice device, const std::vector<
 // Queue‐family finder
 struct QueueFamilyIndices {
     int graphicsFamily = -1, presentFamily = -1;
+    int transferFamily = -1; // transfer-only family, if the device exposes one
     bool isComplete() const { return graphicsFamily >= 0 && presentFamily >= 0; }
 };
 
@@ -46,16 +59,84 @@ static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice dev, VkSurfaceKHR s
     vkGetPhysicalDeviceQueueFamilyProperties(dev, &count, nullptr);
     std::vector<VkQueueFamilyProperties> props(count);
     vkGetPhysicalDeviceQueueFamilyProperties(dev, &count, props.data());
+    bool transferHasCompute = true;
     for (uint32_t i = 0; i < props.size(); i++) {
-        if (props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) indices.graphicsFamily = i;
+        VkQueueFlags flags = props[i].queueFlags;
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && indices.graphicsFamily < 0) indices.graphicsFamily = i;
+        // Headless: nothing is presented, so the graphics family will do.
         VkBool32 present = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surf, &present);
-        if (present) indices.presentFamily = i;
-        if (indices.isComplete()) break;
+        if (surf != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surf, &present);
+        else present = (flags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+        if (present && (indices.presentFamily < 0 || (int)i == indices.graphicsFamily))
+            indices.presentFamily = i;
+        // Prefer a pure DMA family over an async-compute one.
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) &&
+            (indices.transferFamily < 0 || (transferHasCompute && !(flags & VK_QUEUE_COMPUTE_BIT)))) {
+            indices.transferFamily = i;
+            transferHasCompute = (flags & VK_QUEUE_COMPUTE_BIT) != 0;
+        }
     }
     return indices;
 }
 
+// Creates a single-level or mipmapped 2D image (or image array) in device-local memory.
+static void createImage2D(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent,
+                          uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage,
+                          VkImage& image, VkDeviceMemory& memory, uint32_t arrayLayers = 1) {
+    VkImageCreateInfo ici{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    ici.imageType = VK_IMAGE_TYPE_2D;
+    ici.format = format;
+    ici.extent = { extent.width, extent.height, 1 };
+    ici.mipLevels = mipLevels;
+    ici.arrayLayers = arrayLayers;
+    ici.samples = VK_SAMPLE_COUNT_1_BIT;
+    ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+    ici.usage = usage;
+    ici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &ici, nullptr, &image) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create image");
+
+    VkMemoryRequirements memReq;
+    vkGetImageMemoryRequirements(device, image, &memReq);
+    VkMemoryAllocateInfo mai{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    mai.allocationSize = memReq.size;
+    mai.memoryTypeIndex = findMemoryType(physicalDevice, memReq.memoryTypeBits,
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkAllocateMemory(device, &mai, nullptr, &memory) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate image memory");
+    vkBindImageMemory(device, image, memory, 0);
+}
+
+static VkImageView createImageView2D(VkDevice device, VkImage image, VkFormat format,
+                                     VkImageAspectFlags aspect, uint32_t baseMip, uint32_t mipCount) {
+    VkImageViewCreateInfo vi{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    vi.image = image;
+    vi.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    vi.format = format;
+    vi.subresourceRange = { aspect, baseMip, mipCount, 0, 1 };
+    VkImageView view;
+    if (vkCreateImageView(device, &vi, nullptr, &view) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create image view");
+    return view;
+}
+
+// Depth format, picked before the render pass: it has to be sampleable for the
+// Hi-Z build.
+static VkFormat findDepthFormat(VkPhysicalDevice physicalDevice) {
+    const VkFormat candidates[] = {
+        VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT
+    };
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    for (VkFormat f : candidates) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, f, &props);
+        if ((props.optimalTilingFeatures & needed) == needed) return f;
+    }
+    throw std::runtime_error("Failed to find a sampleable depth format");
+}
+
 // 1. Instance
 void VulkanApp::createInstance() {
     VkApplicationInfo appInfo{ VK_STRUCTURE_TYPE_APPLICATION_INFO };
@@ -68,7 +149,7 @@ void VulkanApp::createInstance() {
     VkInstanceCreateInfo ci{ VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
     ci.pApplicationInfo = &appInfo;
     uint32_t extCount = 0;
-    const char** exts = glfwGetRequiredInstanceExtensions(&extCount);
+    const char** exts = headlessMode ? nullptr : glfwGetRequiredInstanceExtensions(&extCount);
     ci.enabledExtensionCount = extCount;
     ci.ppEnabledExtensionNames = exts;
     ci.enabledLayerCount = 0;
@@ -79,6 +160,7 @@ void VulkanApp::createInstance() {
 
 // 2. Surface
 void VulkanApp::createSurface() {
+    if (headlessMode) return;
     if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
         throw std::runtime_error("Failed to create window surface");
 }
@@ -97,6 +179,11 @@ void VulkanApp::pickPhysicalDevice() {
             physicalDevice = dev;
             graphicsQueueFamilyIndex = idx.graphicsFamily;
             presentQueueFamilyIndex = idx.presentFamily;
+            transferQueueFamilyIndex = idx.transferFamily >= 0 ? idx.transferFamily
+                                                                : idx.graphicsFamily;
+            VkPhysicalDeviceProperties props;
+            vkGetPhysicalDeviceProperties(dev, &props);
+            gpuName = props.deviceName;
             break;
         }
     }
@@ -106,7 +193,8 @@ void VulkanApp::pickPhysicalDevice() {
 
 // 4. Logical device & queues
 void VulkanApp::createLogicalDevice() {
-    std::set<uint32_t> qfs = { graphicsQueueFamilyIndex, presentQueueFamilyIndex };
+    std::set<uint32_t> qfs = { graphicsQueueFamilyIndex, presentQueueFamilyIndex,
+                               transferQueueFamilyIndex };
     float prio = 1.0f;
     std::vector<VkDeviceQueueCreateInfo> qis;
     for (auto qf : qfs) {
@@ -115,22 +203,75 @@ void VulkanApp::createLogicalDevice() {
         qis.push_back(qi);
     }
     VkPhysicalDeviceFeatures feats{};
+    std::vector<const char*> devExts;
+    if (!headlessMode) devExts.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    const size_t baseExtCount = devExts.size();
+    bool drawIndirectCount = false;
+    if (gpuDriven) {
+        // Both are optional: without them the culled draws are issued one
+        // indirect command at a time, or with culled slots left at zero instances.
+        VkPhysicalDeviceFeatures supported;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+        feats.multiDrawIndirect = supported.multiDrawIndirect;
+        feats.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+        multiDrawIndirect = supported.multiDrawIndirect == VK_TRUE;
+
+        uint32_t extCount = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr);
+        std::vector<VkExtensionProperties> exts(extCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, exts.data());
+        for (auto& e : exts)
+            if (strcmp(e.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+                drawIndirectCount = true;
+        if (drawIndirectCount) devExts.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+        // Indirect draws find their chunk origin through firstInstance.
+        if (!supported.drawIndirectFirstInstance) {
+            std::cout << "drawIndirectFirstInstance is not supported, using CPU-recorded draws\n";
+            gpuDriven = false;
+            multiDrawIndirect = false;
+            drawIndirectCount = false;
+            feats = VkPhysicalDeviceFeatures{};
+            devExts.resize(baseExtCount);
+        }
+    }
+    // Optional too: pipeline statistics for the GPU timer.
+    VkPhysicalDeviceFeatures supported;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+    feats.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+    feats.inheritedQueries = supported.pipelineStatisticsQuery ? supported.inheritedQueries : VK_FALSE;
+    pipelineStatisticsQuery = feats.pipelineStatisticsQuery == VK_TRUE;
+    inheritedQueries = feats.inheritedQueries == VK_TRUE;
     VkDeviceCreateInfo di{ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
     di.queueCreateInfoCount = (uint32_t)qis.size();
     di.pQueueCreateInfos = qis.data();
     di.pEnabledFeatures = &feats;
-    const char* devExts[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
-    di.enabledExtensionCount = 1;
-    di.ppEnabledExtensionNames = devExts;
+    di.enabledExtensionCount = (uint32_t)devExts.size();
+    di.ppEnabledExtensionNames = devExts.data();
     di.enabledLayerCount = 0;
     if (vkCreateDevice(physicalDevice, &di, nullptr, &device) != VK_SUCCESS)
         throw std::runtime_error("Failed to create logical device");
     vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsQueue);
     vkGetDeviceQueue(device, presentQueueFamilyIndex, 0, &presentQueue);
+    vkGetDeviceQueue(device, transferQueueFamilyIndex, 0, &transferQueue);
+    if (drawIndirectCount)
+        cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+}
+
+// Loaded before any pipeline is built and written back in cleanup().
+void VulkanApp::createPipelineCache() {
+    pipelineCache.init(device, physicalDevice, PIPELINE_CACHE_PATH);
+    if (pipelineCache.warm())
+        std::cout << "Loaded " << (pipelineCache.loadedSize() >> 10) << " KiB pipeline cache\n";
 }
 
 // 5. Swapchain
 void VulkanApp::createSwapchain() {
+    if (headlessMode) {
+        createOffscreenTargets();
+        return;
+    }
     VkSurfaceCapabilitiesKHR caps;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &caps);
     uint32_t imgCount = caps.minImageCount + 1;
@@ -146,6 +287,11 @@ void VulkanApp::createSwapchain() {
         fmt.format = VK_FORMAT_B8G8R8A8_SRGB;
         fmt.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
     }
+    // On recreation keep the format the render pass and pipelines were built for.
+    for (auto& f : fmts)
+        if (swapchainImageFormat != VK_FORMAT_UNDEFINED && f.format == swapchainImageFormat) fmt = f;
+    if (swapchainImageFormat != VK_FORMAT_UNDEFINED && fmt.format != swapchainImageFormat)
+        throw std::runtime_error("Surface no longer supports the swapchain format");
 
     uint32_t pmCount = 0;
     vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &pmCount, nullptr);
@@ -160,7 +306,10 @@ void VulkanApp::createSwapchain() {
     else {
         int w, h;
         glfwGetFramebufferSize(window, &w, &h);
-        swapchainExtent = { (uint32_t)w, (uint32_t)h };
+        swapchainExtent = {
+            std::clamp((uint32_t)w, caps.minImageExtent.width, caps.maxImageExtent.width),
+            std::clamp((uint32_t)h, caps.minImageExtent.height, caps.maxImageExtent.height)
+        };
     }
 
     VkSwapchainCreateInfoKHR sci{ VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
@@ -184,10 +333,14 @@ void VulkanApp::createSwapchain() {
     sci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     sci.presentMode = pm;
     sci.clipped = VK_TRUE;
-    sci.oldSwapchain = VK_NULL_HANDLE;
+    sci.oldSwapchain = swapchain; // lets the driver hand resources over on recreation
 
-    if (vkCreateSwapchainKHR(device, &sci, nullptr, &swapchain) != VK_SUCCESS)
+    VkSwapchainKHR newSwapchain;
+    if (vkCreateSwapchainKHR(device, &sci, nullptr, &newSwapchain) != VK_SUCCESS)
         throw std::runtime_error("Failed to create swapchain");
+    // The old one may still have presents pending; drawFrame destroys it later.
+    if (swapchain != VK_NULL_HANDLE) retiredSwapchains.push_back({ swapchain, frameNumber });
+    swapchain = newSwapchain;
 
     vkGetSwapchainImagesKHR(device, swapchain, &imgCount, nullptr);
     swapchainImages.resize(imgCount);
@@ -195,6 +348,19 @@ void VulkanApp::createSwapchain() {
     swapchainImageFormat = fmt.format;
 }
 
+// Headless stand-in for the swapchain: one colour target per frame in flight,
+// so a frame never waits on an image other than its own.
+void VulkanApp::createOffscreenTargets() {
+    swapchainImageFormat = OFFSCREEN_FORMAT;
+    swapchainExtent = headlessExtent;
+    swapchainImages.resize(MAX_FRAMES_IN_FLIGHT);
+    offscreenMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        createImage2D(device, physicalDevice, swapchainExtent, 1, swapchainImageFormat,
+                      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                      swapchainImages[i], offscreenMemory[i]);
+}
+
 // 6. Image Views
 void VulkanApp::createImageViews() {
     swapchainImageViews.resize(swapchainImages.size());
@@ -217,6 +383,7 @@ void VulkanApp::createImageViews() {
 
 // 7. Render pass
 void VulkanApp::createRenderPass() {
+    depthFormat = findDepthFormat(physicalDevice);
     VkAttachmentDescription ca{};
     ca.format = swapchainImageFormat;
     ca.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -225,20 +392,56 @@ void VulkanApp::createRenderPass() {
     ca.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     ca.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     ca.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    ca.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // PRESENT_SRC belongs to VK_KHR_swapchain, which headless mode doesn't enable.
+    ca.finalLayout = headlessMode ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    // Depth is kept after the pass: the Hi-Z build samples it.
+    VkAttachmentDescription da{};
+    da.format = depthFormat;
+    da.samples = VK_SAMPLE_COUNT_1_BIT;
+    da.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    da.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    da.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    da.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    da.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    da.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     VkAttachmentReference cr{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkAttachmentReference dr{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
 
     VkSubpassDescription sp{};
     sp.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     sp.colorAttachmentCount = 1;
     sp.pColorAttachments = &cr;
+    sp.pDepthStencilAttachment = &dr;
+
+    // In: wait for the acquired image and for the previous frame's Hi-Z build
+    // to finish reading depth. Out: make depth visible to this frame's build.
+    VkSubpassDependency deps[2]{};
+    deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    deps[0].dstSubpass = 0;
+    deps[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    deps[0].srcAccessMask = 0;
+    deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    deps[1].srcSubpass = 0;
+    deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    deps[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    deps[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
+    VkAttachmentDescription atts[] = { ca, da };
     VkRenderPassCreateInfo rpci{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-    rpci.attachmentCount = 1;
-    rpci.pAttachments = &ca;
+    rpci.attachmentCount = 2;
+    rpci.pAttachments = atts;
     rpci.subpassCount = 1;
     rpci.pSubpasses = &sp;
+    rpci.dependencyCount = 2;
+    rpci.pDependencies = deps;
 
     if (vkCreateRenderPass(device, &rpci, nullptr, &renderPass) != VK_SUCCESS)
         throw std::runtime_error("Failed to create render pass");
@@ -255,6 +458,11 @@ void VulkanApp::createGraphicsPipeline() {
     vertStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertStage.module = vertModule;
     vertStage.pName = "main";
+    // Selects where the vertex shader reads the chunk origin from.
+    VkBool32 indirectOrigins = gpuDriven ? VK_TRUE : VK_FALSE;
+    VkSpecializationMapEntry specEntry{ 0, 0, sizeof(VkBool32) };
+    VkSpecializationInfo specInfo{ 1, &specEntry, sizeof(VkBool32), &indirectOrigins };
+    vertStage.pSpecializationInfo = &specInfo;
     VkPipelineShaderStageCreateInfo fragStage{ VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
     fragStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragStage.module = fragModule;
@@ -273,14 +481,14 @@ void VulkanApp::createGraphicsPipeline() {
     iaInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     iaInfo.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport{ 0.0f, 0.0f,
-        (float)swapchainExtent.width, (float)swapchainExtent.height,
-        0.0f, 1.0f
-    };
-    VkRect2D scissor{ {0,0}, swapchainExtent };
+    // Viewport and scissor are dynamic so the pipelines outlive swapchain resizes.
     VkPipelineViewportStateCreateInfo vpInfo{ VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
-    vpInfo.viewportCount = 1; vpInfo.pViewports = &viewport;
-    vpInfo.scissorCount = 1; vpInfo.pScissors = &scissor;
+    vpInfo.viewportCount = 1;
+    vpInfo.scissorCount = 1;
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynInfo{ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+    dynInfo.dynamicStateCount = 2;
+    dynInfo.pDynamicStates = dynamicStates;
 
     VkPipelineRasterizationStateCreateInfo rsInfo{ VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
     rsInfo.depthClampEnable = VK_FALSE;
@@ -301,8 +509,28 @@ void VulkanApp::createGraphicsPipeline() {
     VkPipelineColorBlendStateCreateInfo cbInfo{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
     cbInfo.attachmentCount = 1; cbInfo.pAttachments = &cbAtt;
 
+    // The pre-pass has already laid down depth, so only the nearest surface
+    // reaches the fragment shader.
+    VkPipelineDepthStencilStateCreateInfo dsInfo{ VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    dsInfo.depthTestEnable = VK_TRUE;
+    dsInfo.depthWriteEnable = VK_FALSE;
+    dsInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkDescriptorSetLayoutBinding bindings[4]{};
+    bindings[0] = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+    bindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+    bindings[2] = { 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    bindings[3] = { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    VkDescriptorSetLayoutCreateInfo dslci{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    dslci.bindingCount = 4;
+    dslci.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &dslci, nullptr, &graphicsSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create graphics descriptor set layout");
+
+    VkPushConstantRange pcr{ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec4) }; // chunk origin
     VkPipelineLayoutCreateInfo plInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-    plInfo.setLayoutCount = 0; plInfo.pushConstantRangeCount = 0;
+    plInfo.setLayoutCount = 1; plInfo.pSetLayouts = &graphicsSetLayout;
+    plInfo.pushConstantRangeCount = 1; plInfo.pPushConstantRanges = &pcr;
     if (vkCreatePipelineLayout(device, &plInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
         throw std::runtime_error("Failed to create pipeline layout");
 
@@ -313,25 +541,80 @@ void VulkanApp::createGraphicsPipeline() {
     gpInfo.pViewportState = &vpInfo;
     gpInfo.pRasterizationState = &rsInfo;
     gpInfo.pMultisampleState = &msInfo;
+    gpInfo.pDepthStencilState = &dsInfo;
     gpInfo.pColorBlendState = &cbInfo;
+    gpInfo.pDynamicState = &dynInfo;
     gpInfo.layout = pipelineLayout;
     gpInfo.renderPass = renderPass;
     gpInfo.subpass = 0;
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &gpInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+    if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &gpInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
         throw std::runtime_error("Failed to create graphics pipeline");
 
+    // Depth pre-pass: vertex stage only, writes depth and no colour.
+    VkPipelineDepthStencilStateCreateInfo prepassDs = dsInfo;
+    prepassDs.depthWriteEnable = VK_TRUE;
+    prepassDs.depthCompareOp = VK_COMPARE_OP_LESS;
+    VkPipelineColorBlendAttachmentState prepassAtt = cbAtt;
+    prepassAtt.colorWriteMask = 0;
+    VkPipelineColorBlendStateCreateInfo prepassCb = cbInfo;
+    prepassCb.pAttachments = &prepassAtt;
+    gpInfo.stageCount = 1;
+    gpInfo.pDepthStencilState = &prepassDs;
+    gpInfo.pColorBlendState = &prepassCb;
+    if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &gpInfo, nullptr, &depthPrepassPipeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create depth pre-pass pipeline");
+
+    // Cutout: alpha-tested in the fragment shader, so it can't take part in
+    // the depth-only pre-pass and writes its own depth after the opaque pass.
+    int32_t alphaMode = 1;
+    VkSpecializationMapEntry alphaEntry{ 0, 0, sizeof(int32_t) };
+    VkSpecializationInfo alphaSpec{ 1, &alphaEntry, sizeof(int32_t), &alphaMode };
+    stages[1].pSpecializationInfo = &alphaSpec;
+    VkPipelineDepthStencilStateCreateInfo cutoutDs = dsInfo;
+    cutoutDs.depthWriteEnable = VK_TRUE;
+    gpInfo.stageCount = 2;
+    gpInfo.pDepthStencilState = &cutoutDs;
+    gpInfo.pColorBlendState = &cbInfo;
+    if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &gpInfo, nullptr, &cutoutPipeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create cutout pipeline");
+
+    // Translucent: blended over everything else, depth-tested but never
+    // writing depth, so sorted draws composite correctly.
+    alphaMode = 2;
+    VkPipelineColorBlendAttachmentState blendAtt = cbAtt;
+    blendAtt.blendEnable = VK_TRUE;
+    blendAtt.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAtt.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAtt.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAtt.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAtt.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAtt.alphaBlendOp = VK_BLEND_OP_ADD;
+    VkPipelineColorBlendStateCreateInfo blendCb = cbInfo;
+    blendCb.pAttachments = &blendAtt;
+    gpInfo.pDepthStencilState = &dsInfo;
+    gpInfo.pColorBlendState = &blendCb;
+    if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &gpInfo, nullptr, &translucentPipeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create translucent pipeline");
+
     vkDestroyShaderModule(device, fragModule, nullptr);
     vkDestroyShaderModule(device, vertModule, nullptr);
 }
 
+void VulkanApp::createDepthResources() {
+    createImage2D(device, physicalDevice, swapchainExtent, 1, depthFormat,
+                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                  depthImage, depthMemory);
+    depthView = createImageView2D(device, depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+}
+
 // 9. Framebuffers
 void VulkanApp::createFramebuffers() {
     swapchainFramebuffers.resize(swapchainImageViews.size());
     for (size_t i = 0; i < swapchainImageViews.size(); i++) {
-        VkImageView atts[] = { swapchainImageViews[i] };
+        VkImageView atts[] = { swapchainImageViews[i], depthView };
         VkFramebufferCreateInfo fbci{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
         fbci.renderPass = renderPass;
-        fbci.attachmentCount = 1;
+        fbci.attachmentCount = 2;
         fbci.pAttachments = atts;
         fbci.width = swapchainExtent.width;
         fbci.height = swapchainExtent.height;
@@ -350,113 +633,1395 @@ void VulkanApp::createCommandPool() {
         throw std::runtime_error("Failed to create command pool");
 }
 
-// 11. Command buffers + draw triangle
+// Mesh pools and the staging ring that feeds them. Vertex ranges are aligned
+// to whole vertices and index ranges to whole indices, so offsets double as
+// vertexOffset/firstIndex in draws.
+void VulkanApp::createMeshPools() {
+    // GPU-driven mode draws everything from block 0, so it gets one big block.
+    uint32_t maxBlocks = gpuDriven ? 1 : UINT32_MAX;
+    vertexPool.init(device, physicalDevice,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        gpuDriven ? GPU_DRIVEN_VERTEX_BUFFER_SIZE : MESH_VERTEX_BLOCK_SIZE, sizeof(Vertex), maxBlocks);
+    indexPool.init(device, physicalDevice,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        gpuDriven ? GPU_DRIVEN_INDEX_BUFFER_SIZE : MESH_INDEX_BLOCK_SIZE, sizeof(uint32_t), maxBlocks);
+    uploader.init(device, physicalDevice, transferQueue, transferQueueFamilyIndex,
+                  graphicsQueueFamilyIndex, STAGING_RING_SIZE);
+    if (uploader.dedicated())
+        std::cout << "Streaming meshes on transfer queue family " << transferQueueFamilyIndex << "\n";
+}
+
+// 11. Command buffers (one per frame in flight, re-recorded every frame)
 void VulkanApp::createCommandBuffers() {
-    commandBuffers.resize(swapchainFramebuffers.size());
+    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
     VkCommandBufferAllocateInfo cbai{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
     cbai.commandPool = commandPool;
     cbai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     cbai.commandBufferCount = (uint32_t)commandBuffers.size();
     if (vkAllocateCommandBuffers(device, &cbai, commandBuffers.data()) != VK_SUCCESS)
         throw std::runtime_error("Failed to allocate command buffers");
+}
+
+void VulkanApp::createWorkerCommandPools() {
+    if (!recordPool) return;
+    recordThreads = recordPool->size();
+    workerCommandPools.resize(MAX_FRAMES_IN_FLIGHT * recordThreads);
+    secondaryCommandBuffers.resize(workerCommandPools.size() * SECONDARIES_PER_SLICE);
+    for (size_t i = 0; i < workerCommandPools.size(); i++) {
+        // Pools are reset wholesale each frame, so no per-buffer reset flag.
+        VkCommandPoolCreateInfo cpci{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+        cpci.queueFamilyIndex = graphicsQueueFamilyIndex;
+        cpci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        if (vkCreateCommandPool(device, &cpci, nullptr, &workerCommandPools[i]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create worker command pool");
+
+        VkCommandBufferAllocateInfo cbai{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+        cbai.commandPool = workerCommandPools[i];
+        cbai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        cbai.commandBufferCount = (uint32_t)SECONDARIES_PER_SLICE;
+        if (vkAllocateCommandBuffers(device, &cbai, &secondaryCommandBuffers[i * SECONDARIES_PER_SLICE]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate secondary command buffer");
+    }
+}
+
+// The compute pipeline that builds the Hi-Z pyramid, one dispatch per level.
+// The pyramid itself follows the swapchain size; see createHiZImages().
+void VulkanApp::createHiZResources() {
+    // Only ever read with texelFetch, so filtering does not matter.
+    VkSamplerCreateInfo sci{ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    sci.magFilter = VK_FILTER_NEAREST;
+    sci.minFilter = VK_FILTER_NEAREST;
+    sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sci.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sci.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sci.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sci.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(device, &sci, nullptr, &hizSampler) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create Hi-Z sampler");
+
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0] = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    bindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    VkDescriptorSetLayoutCreateInfo dslci{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    dslci.bindingCount = 2;
+    dslci.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &dslci, nullptr, &hizSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create Hi-Z descriptor set layout");
+
+    VkPushConstantRange pcr{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(int32_t) * 4 };
+    VkPipelineLayoutCreateInfo plInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    plInfo.setLayoutCount = 1; plInfo.pSetLayouts = &hizSetLayout;
+    plInfo.pushConstantRangeCount = 1; plInfo.pPushConstantRanges = &pcr;
+    if (vkCreatePipelineLayout(device, &plInfo, nullptr, &hizPipelineLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create Hi-Z pipeline layout");
+
+    auto compCode = readFile("shaders/hiz.spv");
+    VkShaderModule compModule = createShaderModule(device, compCode);
+    VkComputePipelineCreateInfo cpInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    cpInfo.stage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+    cpInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    cpInfo.stage.module = compModule;
+    cpInfo.stage.pName = "main";
+    cpInfo.layout = hizPipelineLayout;
+    if (vkCreateComputePipelines(device, pipelineCache.handle(), 1, &cpInfo, nullptr, &hizPipeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create Hi-Z pipeline");
+    vkDestroyShaderModule(device, compModule, nullptr);
+    createHiZImages();
+}
+
+// Hi-Z pyramid over the current depth buffer, and one descriptor set per level.
+void VulkanApp::createHiZImages() {
+    hizExtent = { std::max(1u, swapchainExtent.width / 2), std::max(1u, swapchainExtent.height / 2) };
+    hizLevels = 1;
+    while ((std::max(hizExtent.width, hizExtent.height) >> hizLevels) > 0) hizLevels++;
+    createImage2D(device, physicalDevice, hizExtent, hizLevels, VK_FORMAT_R32_SFLOAT,
+                  VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, hizImage, hizMemory);
+    hizView = createImageView2D(device, hizImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT,
+                                0, hizLevels);
+    hizMipViews.resize(hizLevels);
+    for (uint32_t i = 0; i < hizLevels; i++)
+        hizMipViews[i] = createImageView2D(device, hizImage, VK_FORMAT_R32_SFLOAT,
+                                           VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, hizLevels },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, hizLevels },
+    };
+    VkDescriptorPoolCreateInfo dpci{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    dpci.maxSets = hizLevels;
+    dpci.poolSizeCount = 2;
+    dpci.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &dpci, nullptr, &hizDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create Hi-Z descriptor pool");
+
+    std::vector<VkDescriptorSetLayout> layouts(hizLevels, hizSetLayout);
+    hizDescriptorSets.resize(hizLevels);
+    VkDescriptorSetAllocateInfo dsai{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    dsai.descriptorPool = hizDescriptorPool;
+    dsai.descriptorSetCount = hizLevels;
+    dsai.pSetLayouts = layouts.data();
+    if (vkAllocateDescriptorSets(device, &dsai, hizDescriptorSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate Hi-Z descriptor sets");
+    for (uint32_t i = 0; i < hizLevels; i++) {
+        VkDescriptorImageInfo src = i == 0
+            ? VkDescriptorImageInfo{ hizSampler, depthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }
+            : VkDescriptorImageInfo{ hizSampler, hizMipViews[i - 1], VK_IMAGE_LAYOUT_GENERAL };
+        VkDescriptorImageInfo dst{ VK_NULL_HANDLE, hizMipViews[i], VK_IMAGE_LAYOUT_GENERAL };
+        VkWriteDescriptorSet writes[2] = {
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+        };
+        writes[0].dstSet = hizDescriptorSets[i];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &src;
+        writes[1].dstSet = hizDescriptorSets[i];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &dst;
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+    hizValid = false;
+
+    // The culling pass samples the whole pyramid.
+    for (auto& f : cullFrames) {
+        VkDescriptorImageInfo hizInfo{ hizSampler, hizView, VK_IMAGE_LAYOUT_GENERAL };
+        VkWriteDescriptorSet write{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        write.dstSet = f.descriptorSet;
+        write.dstBinding = 4;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &hizInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+}
+
+void VulkanApp::destroyHiZImages() {
+    vkDestroyDescriptorPool(device, hizDescriptorPool, nullptr);
+    hizDescriptorSets.clear();
+    for (auto view : hizMipViews) vkDestroyImageView(device, view, nullptr);
+    hizMipViews.clear();
+    vkDestroyImageView(device, hizView, nullptr);
+    vkDestroyImage(device, hizImage, nullptr);
+    vkFreeMemory(device, hizMemory, nullptr);
+}
+
+// Per-frame culling buffers and the compute pipeline that fills them.
+void VulkanApp::createCullingResources() {
+    const VkDescriptorType types[7] = {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // chunk infos
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // draw commands
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // draw count
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,          // CullParams
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // Hi-Z
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // per-chunk results
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,          // stats
+    };
+    VkDescriptorSetLayoutBinding bindings[7]{};
+    for (uint32_t i = 0; i < 7; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = types[i];
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo dslci{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    dslci.bindingCount = 7;
+    dslci.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &dslci, nullptr, &cullSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create cull descriptor set layout");
+
+    VkPipelineLayoutCreateInfo plInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    plInfo.setLayoutCount = 1; plInfo.pSetLayouts = &cullSetLayout;
+    if (vkCreatePipelineLayout(device, &plInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create cull pipeline layout");
+
+    auto compCode = readFile("shaders/cull.spv");
+    VkShaderModule compModule = createShaderModule(device, compCode);
+    VkComputePipelineCreateInfo cpInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    cpInfo.stage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+    cpInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    cpInfo.stage.module = compModule;
+    cpInfo.stage.pName = "main";
+    cpInfo.layout = cullPipelineLayout;
+    if (vkCreateComputePipelines(device, pipelineCache.handle(), 1, &cpInfo, nullptr, &cullPipeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create cull pipeline");
+    vkDestroyShaderModule(device, compModule, nullptr);
+
+    const uint32_t frames = (uint32_t)MAX_FRAMES_IN_FLIGHT;
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * frames },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frames },
+    };
+    VkDescriptorPoolCreateInfo dpci{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    dpci.maxSets = frames;
+    dpci.poolSizeCount = 3;
+    dpci.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &dpci, nullptr, &cullDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create cull descriptor pool");
+
+    const VkMemoryPropertyFlags hostVisible =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkDeviceSize infoSize = sizeof(ChunkDrawInfo) * MAX_GPU_CHUNKS;
+    VkDeviceSize drawSize = sizeof(VkDrawIndexedIndirectCommand) * MAX_GPU_CHUNKS;
+    VkDeviceSize resultSize = sizeof(uint32_t) * MAX_GPU_CHUNKS;
+    cullFrames.resize(MAX_FRAMES_IN_FLIGHT);
+    for (auto& f : cullFrames) {
+        createBuffer(infoSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible,
+                     f.chunkInfoBuffer, f.chunkInfoMemory);
+        vkMapMemory(device, f.chunkInfoMemory, 0, infoSize, 0, reinterpret_cast<void**>(&f.chunkInfos));
+        createBuffer(drawSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, f.drawBuffer, f.drawMemory);
+        createBuffer(sizeof(uint32_t),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, f.countBuffer, f.countMemory);
+        createBuffer(sizeof(CullParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible,
+                     f.paramsBuffer, f.paramsMemory);
+        vkMapMemory(device, f.paramsMemory, 0, sizeof(CullParams), 0, reinterpret_cast<void**>(&f.params));
+        createBuffer(resultSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible,
+                     f.resultBuffer, f.resultMemory);
+        vkMapMemory(device, f.resultMemory, 0, resultSize, 0, reinterpret_cast<void**>(&f.results));
+        createBuffer(sizeof(ChunkCullStats),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible,
+                     f.statsBuffer, f.statsMemory);
+        vkMapMemory(device, f.statsMemory, 0, sizeof(ChunkCullStats), 0, reinterpret_cast<void**>(&f.stats));
+
+        VkDescriptorSetAllocateInfo dsai{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        dsai.descriptorPool = cullDescriptorPool;
+        dsai.descriptorSetCount = 1;
+        dsai.pSetLayouts = &cullSetLayout;
+        if (vkAllocateDescriptorSets(device, &dsai, &f.descriptorSet) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate cull descriptor set");
+
+        VkDescriptorBufferInfo bufferInfos[7] = {
+            { f.chunkInfoBuffer, 0, VK_WHOLE_SIZE },
+            { f.drawBuffer, 0, VK_WHOLE_SIZE },
+            { f.countBuffer, 0, VK_WHOLE_SIZE },
+            { f.paramsBuffer, 0, VK_WHOLE_SIZE },
+            {},
+            { f.resultBuffer, 0, VK_WHOLE_SIZE },
+            { f.statsBuffer, 0, VK_WHOLE_SIZE },
+        };
+        VkDescriptorImageInfo hizInfo{ hizSampler, hizView, VK_IMAGE_LAYOUT_GENERAL };
+        VkWriteDescriptorSet writes[7]{};
+        for (uint32_t i = 0; i < 7; i++) {
+            writes[i] = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+            writes[i].dstSet = f.descriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = types[i];
+            if (types[i] == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) writes[i].pImageInfo = &hizInfo;
+            else writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(device, 7, writes, 0, nullptr);
+    }
+    if (gpuDriven)
+        std::cout << "GPU-driven drawing: "
+                  << (cmdDrawIndexedIndirectCount ? "indirect count" :
+                      multiDrawIndirect ? "multi-draw indirect" : "single-draw indirect") << "\n";
+}
+
+// Generates every registered block texture, uploads them into one array with
+// a full mip chain (built on the GPU by blitting each level from the one
+// above) and uploads the material table next to it. Runs once at startup, so
+// it simply waits for the graphics queue.
+void VulkanApp::createBlockTextures() {
+    const auto& names = BlockRegistry::textures();
+    const uint32_t layers = (uint32_t)names.size();
+    const uint32_t texels = BLOCK_TEXTURE_SIZE * BLOCK_TEXTURE_SIZE;
+    uint32_t mipLevels = 1;
+    while ((BLOCK_TEXTURE_SIZE >> mipLevels) > 0) mipLevels++;
+
+    const BlockView blocks = BlockRegistry::view();
+    std::vector<GpuBlockMaterial> materials(BlockRegistry::count());
+    for (size_t id = 0; id < materials.size(); id++) {
+        for (int face = 0; face < 6; face++)
+            materials[id].faceLayers[face] = blocks.faceLayer((BlockRegistry::BlockID)id, face);
+        materials[id].tint = blocks.tint((BlockRegistry::BlockID)id);
+        materials[id].pad = 0;
+    }
+
+    VkDeviceSize pixelBytes = VkDeviceSize(texels) * layers * sizeof(uint32_t);
+    VkDeviceSize materialBytes = materials.size() * sizeof(GpuBlockMaterial);
+    VkBuffer staging;
+    VkDeviceMemory stagingMemory;
+    createBuffer(pixelBytes + materialBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 staging, stagingMemory);
+    uint8_t* mapped;
+    vkMapMemory(device, stagingMemory, 0, pixelBytes + materialBytes, 0, reinterpret_cast<void**>(&mapped));
+    for (uint32_t layer = 0; layer < layers; layer++)
+        generateBlockTexture(names[layer], BLOCK_TEXTURE_SIZE,
+                             reinterpret_cast<uint32_t*>(mapped) + size_t(layer) * texels);
+    std::memcpy(mapped + pixelBytes, materials.data(), (size_t)materialBytes);
+    vkUnmapMemory(device, stagingMemory);
+
+    createBuffer(materialBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, materialBuffer, materialMemory);
+    // R8G8B8A8_SRGB is required to support linear blits, so no format query.
+    const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    createImage2D(device, physicalDevice, { BLOCK_TEXTURE_SIZE, BLOCK_TEXTURE_SIZE }, mipLevels, format,
+                  VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                  blockTextureImage, blockTextureMemory, layers);
+
+    VkCommandBufferAllocateInfo ai{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    ai.commandPool = commandPool;
+    ai.commandBufferCount = 1;
+    VkCommandBuffer cb;
+    vkAllocateCommandBuffers(device, &ai, &cb);
+    VkCommandBufferBeginInfo bi{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cb, &bi);
+
+    auto barrier = [&](uint32_t level, VkImageLayout from, VkImageLayout to,
+                       VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                       VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+        VkImageMemoryBarrier b{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        b.srcAccessMask = srcAccess;
+        b.dstAccessMask = dstAccess;
+        b.oldLayout = from;
+        b.newLayout = to;
+        b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        b.image = blockTextureImage;
+        b.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, layers };
+        vkCmdPipelineBarrier(cb, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &b);
+    };
+    for (uint32_t level = 0; level < mipLevels; level++)
+        barrier(level, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkBufferImageCopy copy{};
+    copy.bufferOffset = 0;
+    copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, layers };
+    copy.imageExtent = { BLOCK_TEXTURE_SIZE, BLOCK_TEXTURE_SIZE, 1 };
+    vkCmdCopyBufferToImage(cb, staging, blockTextureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+    VkBufferCopy materialCopy{ pixelBytes, 0, materialBytes };
+    vkCmdCopyBuffer(cb, staging, materialBuffer, 1, &materialCopy);
+
+    for (uint32_t level = 1; level < mipLevels; level++) {
+        barrier(level - 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        int32_t src = (int32_t)(BLOCK_TEXTURE_SIZE >> (level - 1));
+        int32_t dst = std::max(src / 2, 1);
+        VkImageBlit blit{};
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, layers };
+        blit.srcOffsets[1] = { src, src, 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, layers };
+        blit.dstOffsets[1] = { dst, dst, 1 };
+        vkCmdBlitImage(cb, blockTextureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       blockTextureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+        barrier(level - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    barrier(mipLevels - 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    VkBufferMemoryBarrier materialBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    materialBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    materialBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    materialBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    materialBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    materialBarrier.buffer = materialBuffer;
+    materialBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 1, &materialBarrier, 0, nullptr);
+    vkEndCommandBuffer(cb);
+
+    VkSubmitInfo si{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    si.commandBufferCount = 1; si.pCommandBuffers = &cb;
+    vkQueueSubmit(graphicsQueue, 1, &si, VK_NULL_HANDLE);
+    vkQueueWaitIdle(graphicsQueue);
+    vkFreeCommandBuffers(device, commandPool, 1, &cb);
+    vkDestroyBuffer(device, staging, nullptr);
+    vkFreeMemory(device, stagingMemory, nullptr);
+
+    VkImageViewCreateInfo vi{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    vi.image = blockTextureImage;
+    vi.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    vi.format = format;
+    vi.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layers };
+    if (vkCreateImageView(device, &vi, nullptr, &blockTextureView) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create block texture view");
+
+    // Nearest texels up close, blended mips in the distance.
+    VkSamplerCreateInfo sci{ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    sci.magFilter = VK_FILTER_NEAREST;
+    sci.minFilter = VK_FILTER_NEAREST;
+    sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sci.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sci.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sci.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sci.maxLod = (float)mipLevels;
+    if (vkCreateSampler(device, &sci, nullptr, &blockTextureSampler) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create block texture sampler");
+
+    std::cout << "Block textures: " << layers << " layers, " << mipLevels << " mips, "
+              << materials.size() << " materials\n";
+}
+
+void VulkanApp::createCameraResources() {
+    const uint32_t frames = (uint32_t)MAX_FRAMES_IN_FLIGHT;
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames * 2 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frames },
+    };
+    VkDescriptorPoolCreateInfo dpci{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    dpci.maxSets = frames;
+    dpci.poolSizeCount = 3;
+    dpci.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &dpci, nullptr, &graphicsDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create graphics descriptor pool");
+
+    cameraBuffers.resize(frames);
+    cameraMemory.resize(frames);
+    cameraUniforms.resize(frames);
+    graphicsDescriptorSets.resize(frames);
+    std::vector<VkDescriptorSetLayout> layouts(frames, graphicsSetLayout);
+    VkDescriptorSetAllocateInfo dsai{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    dsai.descriptorPool = graphicsDescriptorPool;
+    dsai.descriptorSetCount = frames;
+    dsai.pSetLayouts = layouts.data();
+    if (vkAllocateDescriptorSets(device, &dsai, graphicsDescriptorSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate graphics descriptor sets");
+
+    for (uint32_t i = 0; i < frames; i++) {
+        createBuffer(sizeof(CameraUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     cameraBuffers[i], cameraMemory[i]);
+        vkMapMemory(device, cameraMemory[i], 0, sizeof(CameraUniforms), 0,
+                    reinterpret_cast<void**>(&cameraUniforms[i]));
+
+        VkDescriptorBufferInfo camInfo{ cameraBuffers[i], 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo chunkInfo{ cullFrames[i].chunkInfoBuffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorImageInfo textureInfo{ blockTextureSampler, blockTextureView,
+                                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkDescriptorBufferInfo materialInfo{ materialBuffer, 0, VK_WHOLE_SIZE };
+        VkWriteDescriptorSet writes[4] = {
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET },
+        };
+        writes[0].dstSet = graphicsDescriptorSets[i];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[0].pBufferInfo = &camInfo;
+        writes[1].dstSet = graphicsDescriptorSets[i];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].pBufferInfo = &chunkInfo;
+        writes[2].dstSet = graphicsDescriptorSets[i];
+        writes[2].dstBinding = 2;
+        writes[2].descriptorCount = 1;
+        writes[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[2].pImageInfo = &textureInfo;
+        writes[3].dstSet = graphicsDescriptorSets[i];
+        writes[3].dstBinding = 3;
+        writes[3].descriptorCount = 1;
+        writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[3].pBufferInfo = &materialInfo;
+        vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+    }
+}
+
+// Right-handed perspective for Vulkan clip space: depth 0..1 and y pointing
+// down, so geometry keeps its usual GL-style winding.
+static glm::mat4 perspectiveVulkan(float fovY, float aspect, float zNear, float zFar) {
+    float f = 1.f / std::tan(fovY * 0.5f);
+    glm::mat4 m(0.f);
+    m[0][0] = f / aspect;
+    m[1][1] = -f;
+    m[2][2] = zFar / (zNear - zFar);
+    m[2][3] = -1.f;
+    m[3][2] = zNear * zFar / (zNear - zFar);
+    return m;
+}
+
+// Frustum planes (inward, unnormalised) from a Vulkan clip matrix (0 <= z <= w).
+static void extractFrustumPlanes(const glm::mat4& m, glm::vec4 planes[6]) {
+    glm::vec4 r[4];
+    for (int i = 0; i < 4; i++) r[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    for (int i = 0; i < 4; i++) {
+        planes[0][i] = r[3][i] + r[0][i]; // left
+        planes[1][i] = r[3][i] - r[0][i]; // right
+        planes[2][i] = r[3][i] + r[1][i]; // top
+        planes[3][i] = r[3][i] - r[1][i]; // bottom
+        planes[4][i] = r[2][i];           // near
+        planes[5][i] = r[3][i] - r[2][i]; // far
+    }
+}
+
+// Refreshes this frame's chunk table if the draw list changed, then culls it
+// against the frustum and the previous frame's Hi-Z. Recorded outside the
+// render pass.
+void VulkanApp::recordCulling(VkCommandBuffer cb) {
+    CullFrame& f = cullFrames[currentFrame];
+    uint32_t chunkCount = (uint32_t)std::min<size_t>(meshes.size(), MAX_GPU_CHUNKS);
+    if (f.chunkInfoVersion != drawListVersion) {
+        for (uint32_t i = 0; i < chunkCount; i++) {
+            const GpuMesh& mesh = meshes[i];
+            ChunkDrawInfo& info = f.chunkInfos[i];
+            bool drawable = mesh.indexCount > 0 && mesh.uploadTicket <= residentTicket &&
+                            (i >= chunkVisible.size() || chunkVisible[i]);
+            info.boundsMin = glm::vec4(mesh.boundsMin, 0.f);
+            info.boundsMax = glm::vec4(mesh.boundsMax, 0.f);
+            info.origin = glm::vec4(mesh.origin, 0.f);
+            info.indexCount = drawable ? mesh.indexCount : 0;
+            info.firstIndex = (uint32_t)(mesh.indexAlloc.offset / sizeof(uint32_t));
+            info.vertexOffset = (int32_t)(mesh.vertexAlloc.offset / sizeof(Vertex));
+            info.pad = 0;
+        }
+        f.chunkInfoVersion = drawListVersion;
+    }
+
+    CullParams& params = *f.params;
+    params.prevViewProj = hizViewProj;
+    extractFrustumPlanes(cullViewProj, params.planes);
+    params.hizSize = glm::vec2((float)hizExtent.width, (float)hizExtent.height);
+    params.hizLevels = hizValid ? hizLevels : 0;
+    params.chunkCount = chunkCount;
+    params.compact = cmdDrawIndexedIndirectCount ? 1 : 0;
+    f.culledChunks = chunkCount;
+
+    vkCmdFillBuffer(cb, f.countBuffer, 0, sizeof(uint32_t), 0);
+    vkCmdFillBuffer(cb, f.statsBuffer, 0, sizeof(ChunkCullStats), 0);
+    // Also orders the previous frame's Hi-Z writes before this frame's reads.
+    VkMemoryBarrier toCompute{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    toCompute.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    toCompute.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &toCompute, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout,
+                            0, 1, &f.descriptorSet, 0, nullptr);
+    vkCmdDispatch(cb, (chunkCount + 63) / 64, 1, 1);
+
+    // Draw commands feed this frame's draws; results and stats are read on
+    // the host once the frame's fence signals.
+    VkMemoryBarrier toConsumers{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    toConsumers.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    toConsumers.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &toConsumers, 0, nullptr, 0, nullptr);
+}
+
+// Reduces this frame's depth buffer into the Hi-Z pyramid for the next frame.
+// Recorded after the render pass, which leaves depth in SHADER_READ_ONLY.
+void VulkanApp::recordHiZ(VkCommandBuffer cb) {
+    // Previous contents are dead: this frame's culling already read them.
+    VkImageMemoryBarrier toWrite{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    toWrite.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    toWrite.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    toWrite.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toWrite.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    toWrite.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toWrite.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toWrite.image = hizImage;
+    toWrite.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, hizLevels, 0, 1 };
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toWrite);
+
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipeline);
+    VkExtent2D src = swapchainExtent;
+    for (uint32_t level = 0; level < hizLevels; level++) {
+        VkExtent2D dst = { std::max(1u, hizExtent.width >> level), std::max(1u, hizExtent.height >> level) };
+        int32_t sizes[4] = { (int32_t)src.width, (int32_t)src.height, (int32_t)dst.width, (int32_t)dst.height };
+        vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipelineLayout,
+                                0, 1, &hizDescriptorSets[level], 0, nullptr);
+        vkCmdPushConstants(cb, hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), sizes);
+        vkCmdDispatch(cb, (dst.width + 7) / 8, (dst.height + 7) / 8, 1);
+
+        // The next level reads this one.
+        VkImageMemoryBarrier levelDone{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        levelDone.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        levelDone.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        levelDone.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        levelDone.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        levelDone.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        levelDone.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        levelDone.image = hizImage;
+        levelDone.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+        vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &levelDone);
+        src = dst;
+    }
+    hizViewProj = cullViewProj;
+    hizValid = true;
+}
+
+// Picks up the culling results of the frame that last used this slot. Called
+// after its fence has signalled, so the host-visible buffers are final.
+void VulkanApp::readCullResults() {
+    CullFrame& f = cullFrames[currentFrame];
+    if (f.culledChunks == 0) return;
+    lastCullStats = *f.stats;
+    chunkOccluded.assign(meshes.size(), 0);
+    for (uint32_t i = 0; i < f.culledChunks; i++)
+        chunkOccluded[i] = f.results[i] == CULL_OCCLUDED;
+    f.culledChunks = 0;
+}
+
+// Dynamic state is not inherited by secondaries, so every draw list sets it.
+void VulkanApp::setViewportAndScissor(VkCommandBuffer cb) {
+    VkViewport viewport{ 0.0f, 0.0f,
+        (float)swapchainExtent.width, (float)swapchainExtent.height,
+        0.0f, 1.0f
+    };
+    VkRect2D scissor{ {0,0}, swapchainExtent };
+    vkCmdSetViewport(cb, 0, 1, &viewport);
+    vkCmdSetScissor(cb, 0, 1, &scissor);
+}
+
+// The whole draw list in one call when the device allows it, once for the
+// depth pre-pass and once for colour. Without VK_KHR_draw_indirect_count,
+// culled chunks keep their slot with zero instances.
+void VulkanApp::recordIndirectDraws(VkCommandBuffer cb) {
+    const CullFrame& f = cullFrames[currentFrame];
+    uint32_t chunkCount = (uint32_t)meshes.size();
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkBuffer vb = vertexPool.buffer(0);
+    VkDeviceSize zero = 0;
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                            0, 1, &graphicsDescriptorSets[currentFrame], 0, nullptr);
+    vkCmdBindVertexBuffers(cb, 0, 1, &vb, &zero);
+    vkCmdBindIndexBuffer(cb, indexPool.buffer(0), 0, VK_INDEX_TYPE_UINT32);
+    setViewportAndScissor(cb);
+    for (VkPipeline pipeline : { depthPrepassPipeline, graphicsPipeline }) {
+        vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        if (cmdDrawIndexedIndirectCount)
+            cmdDrawIndexedIndirectCount(cb, f.drawBuffer, 0, f.countBuffer, 0, chunkCount, stride);
+        else if (multiDrawIndirect)
+            vkCmdDrawIndexedIndirect(cb, f.drawBuffer, 0, chunkCount, stride);
+        else
+            for (uint32_t i = 0; i < chunkCount; i++)
+                vkCmdDrawIndexedIndirect(cb, f.drawBuffer, i * stride, 1, stride);
+        frameDrawCalls += (cmdDrawIndexedIndirectCount || multiDrawIndirect) ? 1 : chunkCount;
+    }
+}
+
+// Chunks found occluded by a recent culling pass are skipped until a later
+// pass sees them again.
+void VulkanApp::recordDraws(VkCommandBuffer cb, VkPipeline pipeline, size_t first, size_t last) {
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                            0, 1, &graphicsDescriptorSets[currentFrame], 0, nullptr);
+    setViewportAndScissor(cb);
+    uint32_t draws = 0;
+    uint64_t triangles = 0;
+    for (size_t i = first; i < last; i++) {
+        const GpuMesh& mesh = meshes[i];
+        if (mesh.indexCount == 0 || mesh.uploadTicket > residentTicket) continue;
+        if (i < chunkOccluded.size() && chunkOccluded[i]) continue;
+        if (i < chunkVisible.size() && !chunkVisible[i]) continue;
+        VkBuffer vb = vertexPool.buffer(mesh.vertexAlloc.block);
+        vkCmdBindVertexBuffers(cb, 0, 1, &vb, &mesh.vertexAlloc.offset);
+        vkCmdBindIndexBuffer(cb, indexPool.buffer(mesh.indexAlloc.block),
+                             mesh.indexAlloc.offset, VK_INDEX_TYPE_UINT32);
+        glm::vec4 origin(mesh.origin, 0.f);
+        vkCmdPushConstants(cb, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(origin), &origin);
+        vkCmdDrawIndexed(cb, mesh.indexCount, 1, 0, 0, 0);
+        draws++;
+        triangles += mesh.indexCount / 3;
+    }
+    frameDrawCalls += draws;
+    frameTriangles += triangles;
+}
+
+// Same skip rules as recordDraws, for the cutout and translucent passes.
+bool VulkanApp::layerDrawable(size_t i) const {
+    if (meshes[i].uploadTicket > residentTicket) return false;
+    if (i < chunkOccluded.size() && chunkOccluded[i]) return false;
+    return i >= chunkVisible.size() || chunkVisible[i];
+}
+
+// Cutout then translucent geometry, after all opaque colour. Each draw passes
+// its mesh id as firstInstance so GPU-driven pipelines find the chunk origin.
+void VulkanApp::recordLayerDraws(VkCommandBuffer cb) {
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                            0, 1, &graphicsDescriptorSets[currentFrame], 0, nullptr);
+    setViewportAndScissor(cb);
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, cutoutPipeline);
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const GpuMesh& mesh = meshes[i];
+        if (mesh.cutoutIndexCount == 0 || !layerDrawable(i)) continue;
+        VkBuffer vb = vertexPool.buffer(mesh.vertexAlloc.block);
+        vkCmdBindVertexBuffers(cb, 0, 1, &vb, &mesh.vertexAlloc.offset);
+        vkCmdBindIndexBuffer(cb, indexPool.buffer(mesh.indexAlloc.block),
+                             mesh.indexAlloc.offset, VK_INDEX_TYPE_UINT32);
+        glm::vec4 origin(mesh.origin, 0.f);
+        vkCmdPushConstants(cb, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(origin), &origin);
+        vkCmdDrawIndexed(cb, mesh.cutoutIndexCount, 1, mesh.indexCount, 0, (uint32_t)i);
+        frameDrawCalls++;
+        frameTriangles += mesh.cutoutIndexCount / 3;
+    }
+
+    const TranslucentFrame& t = translucentFrames[currentFrame];
+    if (sortedTranslucent.empty()) return;
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, translucentPipeline);
+    vkCmdBindIndexBuffer(cb, t.buffer, 0, VK_INDEX_TYPE_UINT32);
+    for (uint32_t i : translucentOrder) {
+        const GpuMesh& mesh = meshes[i];
+        if (!layerDrawable(i)) continue;
+        VkBuffer vb = vertexPool.buffer(mesh.vertexAlloc.block);
+        vkCmdBindVertexBuffers(cb, 0, 1, &vb, &mesh.vertexAlloc.offset);
+        glm::vec4 origin(mesh.origin, 0.f);
+        vkCmdPushConstants(cb, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(origin), &origin);
+        vkCmdDrawIndexed(cb, (uint32_t)mesh.translucentIndices.size(), 1, mesh.translucentFirst, 0, i);
+        frameDrawCalls++;
+        frameTriangles += mesh.translucentIndices.size() / 3;
+    }
+}
+
+// Orders chunks with translucent quads far to near, and each chunk's quads
+// far to near, into sortedTranslucent.
+void VulkanApp::sortTranslucent(const glm::vec3& eye) {
+    auto dist2 = [&eye](const glm::vec3& p) { glm::vec3 d = p - eye; return glm::dot(d, d); };
+    std::vector<std::pair<float, uint32_t>> keys;
+    for (uint32_t i = 0; i < meshes.size(); i++)
+        if (!meshes[i].translucentIndices.empty())
+            keys.push_back({ dist2((meshes[i].boundsMin + meshes[i].boundsMax) * 0.5f), i });
+    std::sort(keys.begin(), keys.end(), std::greater<>());
+    translucentOrder.clear();
+    for (auto& k : keys) translucentOrder.push_back(k.second);
 
-    for (size_t i = 0; i < commandBuffers.size(); i++) {
-        VkCommandBufferBeginInfo bi{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-        vkBeginCommandBuffer(commandBuffers[i], &bi);
+    sortedTranslucent.clear();
+    for (uint32_t id : translucentOrder) {
+        GpuMesh& mesh = meshes[id];
+        mesh.translucentFirst = (uint32_t)sortedTranslucent.size();
+        keys.clear();
+        for (uint32_t q = 0; q < mesh.translucentCenters.size(); q++)
+            keys.push_back({ dist2(mesh.translucentCenters[q]), q });
+        std::sort(keys.begin(), keys.end(), std::greater<>());
+        for (auto& k : keys)
+            sortedTranslucent.insert(sortedTranslucent.end(),
+                                     mesh.translucentIndices.begin() + k.second * 6,
+                                     mesh.translucentIndices.begin() + k.second * 6 + 6);
+    }
+    lastSortPosition = eye;
+    translucentDirty = false;
+    translucentVersion++;
+}
 
-        VkClearValue clearCol = { {{0.1f,0.1f,0.1f,1.0f}} };
-        VkRenderPassBeginInfo rpbi{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-        rpbi.renderPass = renderPass;
-        rpbi.framebuffer = swapchainFramebuffers[i];
-        rpbi.renderArea.extent = swapchainExtent;
-        rpbi.clearValueCount = 1;
-        rpbi.pClearValues = &clearCol;
+// This frame's fence has signalled, so its translucent index buffer is free
+// to rewrite (or to replace when it has outgrown it).
+void VulkanApp::updateTranslucentIndices() {
+    TranslucentFrame& t = translucentFrames[currentFrame];
+    if (t.version == translucentVersion) return;
+    if (t.capacity < sortedTranslucent.size()) {
+        if (t.buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, t.buffer, nullptr);
+            vkFreeMemory(device, t.memory, nullptr);
+        }
+        t.capacity = std::max<size_t>(sortedTranslucent.size() * 2, 4096);
+        createBuffer(t.capacity * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     t.buffer, t.memory);
+        vkMapMemory(device, t.memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&t.indices));
+    }
+    if (!sortedTranslucent.empty())
+        std::memcpy(t.indices, sortedTranslucent.data(), sortedTranslucent.size() * sizeof(uint32_t));
+    t.version = translucentVersion;
+}
 
-        vkCmdBeginRenderPass(commandBuffers[i], &rpbi, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+// Runs on a ThreadPool worker. Each slice owns its command pool for the
+// current frame, so no two threads ever touch the same pool.
+std::array<VkCommandBuffer, VulkanApp::SECONDARIES_PER_SLICE>
+VulkanApp::recordSecondary(size_t slice, size_t first, size_t last, uint32_t imageIndex) {
+    PROFILE_ZONE("VulkanApp::recordSecondary");
+    size_t idx = currentFrame * recordThreads + slice;
+    vkResetCommandPool(device, workerCommandPools[idx], 0);
+    std::array<VkCommandBuffer, SECONDARIES_PER_SLICE> cbs;
+    for (size_t i = 0; i < SECONDARIES_PER_SLICE; i++)
+        cbs[i] = secondaryCommandBuffers[idx * SECONDARIES_PER_SLICE + i];
 
-        VkBuffer vbs[] = { vertexBuffer };
-        VkDeviceSize offs[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vbs, offs);
-        vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(commandBuffers[i], indexCount, 1, 0, 0, 0);
-        vkCmdEndRenderPass(commandBuffers[i]);
-        vkEndCommandBuffer(commandBuffers[i]);
+    VkCommandBufferInheritanceInfo ii{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    ii.renderPass = renderPass;
+    ii.subpass = 0;
+    ii.framebuffer = swapchainFramebuffers[imageIndex];
+    if (gpuTimer.statisticsEnabled()) ii.pipelineStatistics = gpuTimer.statisticFlags();
+    VkCommandBufferBeginInfo bi{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+        VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    bi.pInheritanceInfo = &ii;
+    const VkPipeline pipelines[2] = { depthPrepassPipeline, graphicsPipeline };
+    for (int pass = 0; pass < 2; pass++) {
+        if (vkBeginCommandBuffer(cbs[pass], &bi) != VK_SUCCESS)
+            throw std::runtime_error("Failed to begin secondary command buffer");
+        recordDraws(cbs[pass], pipelines[pass], first, last);
+        if (vkEndCommandBuffer(cbs[pass]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to record secondary command buffer");
+    }
+    // The layered passes are ordered across all chunks, so one slice takes them.
+    if (last < meshes.size()) {
+        cbs[2] = VK_NULL_HANDLE;
+        return cbs;
     }
+    if (vkBeginCommandBuffer(cbs[2], &bi) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin secondary command buffer");
+    recordLayerDraws(cbs[2]);
+    if (vkEndCommandBuffer(cbs[2]) != VK_SUCCESS)
+        throw std::runtime_error("Failed to record secondary command buffer");
+    return cbs;
+}
+
+void VulkanApp::recordCommandBuffer(VkCommandBuffer cb, uint32_t imageIndex) {
+    PROFILE_ZONE("VulkanApp::recordCommandBuffer");
+    VkCommandBufferBeginInfo bi{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(cb, &bi) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin command buffer");
+    frameDrawCalls = 0;
+    frameTriangles = 0;
+    gpuTimer.beginFrame(cb, (uint32_t)currentFrame);
+
+    // Take ownership of freshly streamed meshes before anything reads them.
+    uint64_t resident = uploader.acquire(cb, uploadWaitSemaphores[currentFrame]);
+    if (resident != residentTicket) drawListVersion++;
+    residentTicket = resident;
+
+    // This frame's fence has signalled, so its camera buffer is free to update.
+    CameraUniforms& camera = *cameraUniforms[currentFrame];
+    camera.view = cameraView;
+    camera.proj = perspectiveVulkan(glm::radians(CAMERA_FOV_Y),
+                                    (float)swapchainExtent.width / (float)swapchainExtent.height,
+                                    CAMERA_NEAR, CAMERA_FAR);
+    camera.viewProj = camera.proj * camera.view;
+    cullViewProj = camera.viewProj;
+    recordCulling(cb);
+    gpuTimer.mark(cb, "Uploads + culling");
+
+    glm::vec3 eye(glm::inverse(cameraView)[3]);
+    if (translucentDirty || glm::distance(eye, lastSortPosition) > TRANSLUCENT_RESORT_DISTANCE)
+        sortTranslucent(eye);
+    updateTranslucentIndices();
+
+    VkClearValue clearVals[2] = {};
+    clearVals[0].color = { {0.1f,0.1f,0.1f,1.0f} };
+    clearVals[1].depthStencil = { 1.0f, 0 };
+    VkRenderPassBeginInfo rpbi{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+    rpbi.renderPass = renderPass;
+    rpbi.framebuffer = swapchainFramebuffers[imageIndex];
+    rpbi.renderArea.extent = swapchainExtent;
+    rpbi.clearValueCount = 2;
+    rpbi.pClearValues = clearVals;
+
+    // Split the draw list into contiguous slices, one per worker, but only
+    // when there are enough draws to pay for the hand-off.
+    size_t drawCount = meshes.size();
+    size_t slices = std::min(recordThreads,
+        (drawCount + MIN_DRAWS_PER_RECORD_THREAD - 1) / MIN_DRAWS_PER_RECORD_THREAD);
+
+    // Inline passes are timed one by one; secondaries only as a whole, since a
+    // render pass recorded through secondaries can't take timestamps itself.
+    gpuTimer.beginStatistics(cb);
+    if (gpuDriven) {
+        vkCmdBeginRenderPass(cb, &rpbi, VK_SUBPASS_CONTENTS_INLINE);
+        recordIndirectDraws(cb);
+        gpuTimer.mark(cb, "Depth pre-pass + opaque");
+        recordLayerDraws(cb);
+        gpuTimer.mark(cb, "Cutout + translucent");
+    }
+    else if (slices <= 1) {
+        vkCmdBeginRenderPass(cb, &rpbi, VK_SUBPASS_CONTENTS_INLINE);
+        recordDraws(cb, depthPrepassPipeline, 0, drawCount);
+        gpuTimer.mark(cb, "Depth pre-pass");
+        recordDraws(cb, graphicsPipeline, 0, drawCount);
+        gpuTimer.mark(cb, "Opaque");
+        recordLayerDraws(cb);
+        gpuTimer.mark(cb, "Cutout + translucent");
+    }
+    else {
+        std::vector<std::future<std::array<VkCommandBuffer, SECONDARIES_PER_SLICE>>> jobs;
+        jobs.reserve(slices);
+        size_t perSlice = (drawCount + slices - 1) / slices;
+        for (size_t s = 0; s < slices; s++) {
+            size_t first = s * perSlice;
+            size_t last = std::min(drawCount, first + perSlice);
+            jobs.push_back(recordPool->enqueue([this, s, first, last, imageIndex] {
+                return recordSecondary(s, first, last, imageIndex);
+            }));
+        }
+        // Every slice's pre-pass runs before any colour draw, and all opaque
+        // colour before the cutout and translucent passes.
+        std::vector<VkCommandBuffer> secondaries(slices * 2);
+        for (size_t s = 0; s < slices; s++) {
+            auto recorded = jobs[s].get();
+            secondaries[s] = recorded[0];
+            secondaries[slices + s] = recorded[1];
+            if (recorded[2] != VK_NULL_HANDLE) secondaries.push_back(recorded[2]);
+        }
+
+        vkCmdBeginRenderPass(cb, &rpbi, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(cb, (uint32_t)secondaries.size(), secondaries.data());
+    }
+    vkCmdEndRenderPass(cb);
+    gpuTimer.endStatistics(cb);
+    if (!gpuDriven && slices > 1) gpuTimer.mark(cb, "Render pass (secondaries)");
+    recordHiZ(cb);
+    gpuTimer.mark(cb, "Hi-Z");
+    if (vkEndCommandBuffer(cb) != VK_SUCCESS)
+        throw std::runtime_error("Failed to record command buffer");
 }
 
 // 12. Synchronization objects
 void VulkanApp::createSyncObjects() {
+    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    renderFinishedSemaphores.resize(swapchainImages.size());
+    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    imagesInFlight.assign(swapchainImages.size(), VK_NULL_HANDLE);
+    uploadWaitSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+
     VkSemaphoreCreateInfo si{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-    if (vkCreateSemaphore(device, &si, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-        vkCreateSemaphore(device, &si, nullptr, &renderFinishedSemaphore) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create semaphores");
+    VkFenceCreateInfo fi{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    fi.flags = VK_FENCE_CREATE_SIGNALED_BIT; // first wait on each frame must not block
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (vkCreateSemaphore(device, &si, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+            vkCreateFence(device, &fi, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create frame sync objects");
+    }
+    for (auto& sem : renderFinishedSemaphores) {
+        if (vkCreateSemaphore(device, &si, nullptr, &sem) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create semaphores");
+    }
+}
+
+// One timer slot per frame in flight. Pipeline statistics only when the
+// secondary-recorded passes would be counted too, or are never used.
+void VulkanApp::createGpuTimer() {
+    pendingFrameStats.assign(MAX_FRAMES_IN_FLIGHT, FrameStats{ UINT64_MAX });
+    bool statistics = pipelineStatisticsQuery && (inheritedQueries || recordPool == nullptr);
+    gpuTimer.init(device, physicalDevice, graphicsQueueFamilyIndex, MAX_FRAMES_IN_FLIGHT, statistics);
+    if (!gpuTimer.enabled())
+        std::cout << "GPU timestamps are not supported on the graphics queue\n";
+}
+
+// Moves the stats of the frame that last used this slot to the completed list.
+// Only called once the slot's fence has signalled, so the queries are ready.
+void VulkanApp::collectFrameStats(size_t frame) {
+    FrameStats& stats = pendingFrameStats[frame];
+    if (stats.frame == UINT64_MAX) return;
+    // Which indirect draws survived culling is only known once the frame's
+    // cull results are back; each one ran for the depth pre-pass and colour.
+    if (gpuDriven) {
+        const CullFrame& f = cullFrames[frame];
+        for (uint32_t i = 0; i < f.culledChunks; i++)
+            if (f.results[i] == CULL_VISIBLE) stats.triangles += 2 * (f.chunkInfos[i].indexCount / 3);
+    }
+    static Histogram& gpuFrameTime = Metrics::histogram("gpu_frame_time_ms", FRAME_TIME_BOUNDS_MS,
+                                                        "GPU time per frame from timestamps");
+    if (gpuTimer.collect((uint32_t)frame, stats.gpu)) {
+        latestGpuTimings = stats.gpu;
+        gpuFrameTime.observe(stats.gpu.totalMs);
+    }
+    if (frameStatsEnabled) completedFrameStats.push_back(stats);
+    stats.frame = UINT64_MAX;
+}
+
+std::vector<FrameStats> VulkanApp::takeFrameStats() {
+    std::vector<FrameStats> out;
+    out.swap(completedFrameStats);
+    return out;
+}
+
+void VulkanApp::finishFrames() {
+    vkWaitForFences(device, (uint32_t)inFlightFences.size(), inFlightFences.data(),
+                    VK_TRUE, UINT64_MAX);
+    // Oldest first: the slot after the current one was submitted earlier.
+    for (size_t i = 1; i <= MAX_FRAMES_IN_FLIGHT; i++)
+        collectFrameStats((currentFrame + i) % MAX_FRAMES_IN_FLIGHT);
 }
 
 // 13. Upload vertex/index data
-void VulkanApp::uploadMesh(const std::vector<Vertex>& vertices,
-                           const std::vector<uint32_t>& indices) {
-    indexCount = static_cast<uint32_t>(indices.size());
+uint32_t VulkanApp::uploadMesh(const std::vector<Vertex>& vertices,
+                               const std::vector<uint32_t>& indices,
+                               const glm::vec3& origin,
+                               uint32_t cutoutIndexCount,
+                               uint32_t translucentIndexCount) {
+    if (gpuDriven && meshes.size() >= MAX_GPU_CHUNKS)
+        throw std::runtime_error("Too many chunks for GPU-driven drawing");
+    if ((size_t)cutoutIndexCount + translucentIndexCount > indices.size() || translucentIndexCount % 6 != 0)
+        throw std::runtime_error("Invalid mesh render layers");
+    drawListVersion++;
+    GpuMesh mesh;
+    mesh.origin = origin;
+    mesh.indexCount = static_cast<uint32_t>(indices.size()) - cutoutIndexCount - translucentIndexCount;
+    mesh.cutoutIndexCount = cutoutIndexCount;
+    if (indices.empty()) {
+        // Fully buried or empty chunk: keep the slot so ids stay stable.
+        meshes.push_back(mesh);
+        return static_cast<uint32_t>(meshes.size() - 1);
+    }
 
     VkDeviceSize vbSize = sizeof(Vertex) * vertices.size();
-    VkDeviceSize ibSize = sizeof(uint32_t) * indices.size();
+    VkDeviceSize ibSize = sizeof(uint32_t) * (mesh.indexCount + mesh.cutoutIndexCount);
 
-    createBuffer(vbSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-    createBuffer(ibSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+    mesh.boundsMin = mesh.boundsMax = vertices[0].pos;
+    for (auto& v : vertices) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, v.pos);
+        mesh.boundsMax = glm::max(mesh.boundsMax, v.pos);
+    }
+    mesh.boundsMin += origin;
+    mesh.boundsMax += origin;
 
-    VkBuffer stagingVB, stagingIB; VkDeviceMemory stagingVBMem, stagingIBMem;
-    createBuffer(vbSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingVB, stagingVBMem);
-    createBuffer(ibSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingIB, stagingIBMem);
+    // Translucent quads are kept for sorting rather than uploaded.
+    auto translucentBegin = indices.end() - translucentIndexCount;
+    mesh.translucentIndices.assign(translucentBegin, indices.end());
+    for (size_t q = 0; q < mesh.translucentIndices.size(); q += 6) {
+        glm::vec3 lo = vertices[mesh.translucentIndices[q]].pos, hi = lo;
+        for (size_t k = 1; k < 6; k++) {
+            lo = glm::min(lo, vertices[mesh.translucentIndices[q + k]].pos);
+            hi = glm::max(hi, vertices[mesh.translucentIndices[q + k]].pos);
+        }
+        mesh.translucentCenters.push_back(origin + (lo + hi) * 0.5f);
+    }
+    if (translucentIndexCount > 0) translucentDirty = true;
+
+    mesh.vertexAlloc = vertexPool.allocate(vbSize);
+    if (ibSize > 0) mesh.indexAlloc = indexPool.allocate(ibSize);
+    if (!mesh.vertexAlloc.valid() || (ibSize > 0 && !mesh.indexAlloc.valid()))
+        throw std::runtime_error("Out of mesh memory");
+
+    // Staged now, submitted with the rest of this frame's uploads in drawFrame
+    // and drawn from the first frame that has acquired the batch.
+    mesh.uploadTicket = uploader.enqueue(vertices.data(), vbSize,
+                                         vertexPool.buffer(mesh.vertexAlloc.block),
+                                         mesh.vertexAlloc.offset);
+    if (ibSize > 0)
+        mesh.uploadTicket = uploader.enqueue(indices.data(), ibSize,
+                                             indexPool.buffer(mesh.indexAlloc.block),
+                                             mesh.indexAlloc.offset);
+
+    meshes.push_back(mesh);
+    publishMeshMemoryMetrics();
+    return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+void VulkanApp::freeMesh(uint32_t id) {
+    if (id >= meshes.size()) return;
+    GpuMesh& mesh = meshes[id];
+    if (mesh.vertexAlloc.valid() || mesh.indexAlloc.valid())
+        retiredMeshes.push_back({ mesh.vertexAlloc, mesh.indexAlloc, mesh.uploadTicket, frameNumber });
+    // The next sort drops the mesh from translucentOrder before anything is recorded.
+    if (!mesh.translucentIndices.empty()) translucentDirty = true;
+    mesh = GpuMesh{};
+    drawListVersion++;
+}
+
+// Frames up to frameNumber - MAX_FRAMES_IN_FLIGHT have completed once this
+// slot's fence has signalled; a mesh freed at frame F was last drawn by F - 1.
+// With `all`, every frame in flight is known to be done.
+void VulkanApp::releaseRetiredMeshes(bool all) {
+    size_t kept = 0;
+    for (auto& r : retiredMeshes) {
+        bool idle = all || frameNumber + 1 >= r.frame + MAX_FRAMES_IN_FLIGHT;
+        if (!idle || r.uploadTicket > residentTicket) {
+            retiredMeshes[kept++] = r;
+            continue;
+        }
+        if (r.vertexAlloc.valid()) vertexPool.free(r.vertexAlloc);
+        if (r.indexAlloc.valid()) indexPool.free(r.indexAlloc);
+        meshMemoryFreed = true;
+    }
+    if (kept == retiredMeshes.size()) return;
+    retiredMeshes.resize(kept);
+    publishMeshMemoryMetrics();
+}
 
-    void* data;
-    vkMapMemory(device, stagingVBMem, 0, vbSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t)vbSize);
-    vkUnmapMemory(device, stagingVBMem);
-    vkMapMemory(device, stagingIBMem, 0, ibSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)ibSize);
-    vkUnmapMemory(device, stagingIBMem);
+// Only checked after memory was given back, so pools that compaction cannot
+// improve do not stall every frame.
+void VulkanApp::defragmentIfFragmented() {
+    if (!meshMemoryFreed) return;
+    meshMemoryFreed = false;
+    if (vertexPool.stats().fragmentation > DEFRAGMENT_THRESHOLD ||
+        indexPool.stats().fragmentation > DEFRAGMENT_THRESHOLD)
+        defragmentMeshMemory();
+}
 
-    copyBuffer(stagingVB, vertexBuffer, vbSize);
-    copyBuffer(stagingIB, indexBuffer, ibSize);
+void VulkanApp::setChunkVisibility(const std::vector<uint8_t>& visible) {
+    if (visible == chunkVisible) return;
+    chunkVisible = visible;
+    drawListVersion++;
+}
 
-    vkDestroyBuffer(device, stagingVB, nullptr);
-    vkFreeMemory(device, stagingVBMem, nullptr);
-    vkDestroyBuffer(device, stagingIB, nullptr);
-    vkFreeMemory(device, stagingIBMem, nullptr);
+static void logPoolStats(const char* name, const GpuPoolStats& s) {
+    std::cout << name << ": " << (s.used >> 10) << " / " << (s.capacity >> 10) << " KiB in "
+              << s.allocationCount << " ranges over " << s.blockCount << " blocks, "
+              << "largest free " << (s.largestFreeRange >> 10) << " KiB, fragmentation "
+              << int(s.fragmentation * 100.f) << "%\n";
+}
+
+void VulkanApp::publishMeshMemoryMetrics() const {
+    static Gauge& used = Metrics::gauge("gpu_mesh_memory_used_bytes", "Mesh vertex and index bytes in use");
+    static Gauge& capacity = Metrics::gauge("gpu_mesh_memory_capacity_bytes", "Mesh pool bytes allocated from the driver");
+    GpuPoolStats v = vertexPool.stats(), i = indexPool.stats();
+    used.set((int64_t)(v.used + i.used));
+    capacity.set((int64_t)(v.capacity + i.capacity));
+}
+
+void VulkanApp::logMeshMemoryStats() const {
+    logPoolStats("Mesh vertex memory", vertexPool.stats());
+    logPoolStats("Mesh index memory", indexPool.stats());
+}
+
+// Slides meshes down into holes within each block, moves them out of sparsely
+// used blocks and gives the emptied blocks back to the driver. Old ranges are
+// only freed once the copies have completed. Skipped while uploads are still
+// streaming in, since the graphics queue does not own those ranges yet.
+void VulkanApp::defragmentMeshMemory() {
+    if (uploader.lastTicket() > residentTicket) return;
+    // Frames in flight may still read the ranges about to move. Once they are
+    // done, every retired range can go back to the pools before planning.
+    vkWaitForFences(device, (uint32_t)inFlightFences.size(), inFlightFences.data(),
+                    VK_TRUE, UINT64_MAX);
+    releaseRetiredMeshes(true);
+    auto vertexMoves = vertexPool.planDefragment(SIZE_MAX);
+    auto indexMoves = indexPool.planDefragment(SIZE_MAX);
+    if (vertexMoves.empty() && indexMoves.empty()) return;
+
+    VkCommandBufferAllocateInfo ai{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    ai.commandPool = commandPool;
+    ai.commandBufferCount = 1;
+    VkCommandBuffer cb;
+    vkAllocateCommandBuffers(device, &ai, &cb);
+    VkCommandBufferBeginInfo bi{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cb, &bi);
+    for (auto& m : vertexMoves) {
+        VkBufferCopy copy{ m.from.offset, m.to.offset, m.from.size };
+        vkCmdCopyBuffer(cb, vertexPool.buffer(m.from.block), vertexPool.buffer(m.to.block), 1, &copy);
+    }
+    for (auto& m : indexMoves) {
+        VkBufferCopy copy{ m.from.offset, m.to.offset, m.from.size };
+        vkCmdCopyBuffer(cb, indexPool.buffer(m.from.block), indexPool.buffer(m.to.block), 1, &copy);
+    }
+    // The fence wait below only covers the host; later frames read the moved
+    // geometry and later compactions copy it again.
+    VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                            VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+    vkEndCommandBuffer(cb);
+
+    VkFenceCreateInfo fi{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence done;
+    if (vkCreateFence(device, &fi, nullptr, &done) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create defragmentation fence");
+    VkSubmitInfo si{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    si.commandBufferCount = 1; si.pCommandBuffers = &cb;
+    vkQueueSubmit(graphicsQueue, 1, &si, done);
+
+    // No frame is in flight, so once the copies have finished the old ranges
+    // can be recycled.
+    vkWaitForFences(device, 1, &done, VK_TRUE, UINT64_MAX);
+    vkDestroyFence(device, done, nullptr);
+    vkFreeCommandBuffers(device, commandPool, 1, &cb);
+
+    auto repoint = [this](GpuBufferPool& pool, const std::vector<GpuBufferPool::Move>& moves,
+                          GpuAllocation GpuMesh::* field) {
+        std::map<std::pair<uint32_t, VkDeviceSize>, GpuAllocation> moved;
+        for (auto& m : moves) moved[{ m.from.block, m.from.offset }] = m.to;
+        for (auto& mesh : meshes) {
+            auto it = moved.find({ (mesh.*field).block, (mesh.*field).offset });
+            if (it != moved.end()) mesh.*field = it->second;
+        }
+        for (auto& m : moves) pool.free(m.from);
+        pool.releaseEmptyBlocks();
+    };
+    repoint(vertexPool, vertexMoves, &GpuMesh::vertexAlloc);
+    repoint(indexPool, indexMoves, &GpuMesh::indexAlloc);
+    drawListVersion++;
+    publishMeshMemoryMetrics();
+}
+
+// Everything sized by the swapchain. Pipelines, the render pass and all
+// per-frame buffers survive a resize.
+void VulkanApp::destroySwapchainResources() {
+    for (auto fb : swapchainFramebuffers) vkDestroyFramebuffer(device, fb, nullptr);
+    swapchainFramebuffers.clear();
+    destroyHiZImages();
+    vkDestroyImageView(device, depthView, nullptr);
+    vkDestroyImage(device, depthImage, nullptr);
+    vkFreeMemory(device, depthMemory, nullptr);
+    for (auto iv : swapchainImageViews) vkDestroyImageView(device, iv, nullptr);
+    swapchainImageViews.clear();
+}
+
+// Called once this slot's fence has signalled, so frames up to
+// frameNumber - MAX_FRAMES_IN_FLIGHT are done.
+void VulkanApp::destroyRetiredSwapchains() {
+    size_t kept = 0;
+    for (auto& r : retiredSwapchains) {
+        if (frameNumber + 1 >= r.second + 2 * MAX_FRAMES_IN_FLIGHT)
+            vkDestroySwapchainKHR(device, r.first, nullptr);
+        else
+            retiredSwapchains[kept++] = r;
+    }
+    retiredSwapchains.resize(kept);
+}
+
+// Rebuilds the swapchain in place after a resize or an out-of-date present.
+// Only waits for this queue's frames in flight: the device is not idled, so
+// uploads on the transfer queue keep streaming.
+void VulkanApp::recreateSwapchain() {
+    int w = 0, h = 0;
+    glfwGetFramebufferSize(window, &w, &h);
+    if (w == 0 || h == 0) return; // minimised; retried every frame
+
+    auto start = std::chrono::steady_clock::now();
+    vkWaitForFences(device, (uint32_t)inFlightFences.size(), inFlightFences.data(),
+                    VK_TRUE, UINT64_MAX);
+    destroySwapchainResources();
+    createSwapchain();
+    createImageViews();
+    createDepthResources();
+    createFramebuffers();
+    createHiZImages();
+
+    // Semaphores may still be pending in a present, so only ever add more.
+    VkSemaphoreCreateInfo si{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    while (renderFinishedSemaphores.size() < swapchainImages.size()) {
+        VkSemaphore sem;
+        if (vkCreateSemaphore(device, &si, nullptr, &sem) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create semaphores");
+        renderFinishedSemaphores.push_back(sem);
+    }
+    imagesInFlight.assign(swapchainImages.size(), VK_NULL_HANDLE);
+    framebufferResized = false;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Swapchain recreated at " << swapchainExtent.width << "x" << swapchainExtent.height
+              << " in " << ms << " ms\n";
+}
+
+void VulkanApp::toggleFullscreen() {
+    if (glfwGetWindowMonitor(window)) {
+        glfwSetWindowMonitor(window, nullptr, windowedPos[0], windowedPos[1],
+                             windowedSize[0], windowedSize[1], 0);
+        return;
+    }
+    glfwGetWindowPos(window, &windowedPos[0], &windowedPos[1]);
+    glfwGetWindowSize(window, &windowedSize[0], &windowedSize[1]);
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+    glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
 }
 
 // 14. Draw frame
 void VulkanApp::drawFrame() {
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailableSemaphore,
-                          VK_NULL_HANDLE, &imageIndex);
+    PROFILE_ZONE("VulkanApp::drawFrame");
+    static Histogram& frameTime = Metrics::histogram("frame_time_ms", FRAME_TIME_BOUNDS_MS,
+                                                     "CPU time per frame, fence wait included");
+    auto frameStart = std::chrono::steady_clock::now();
+    // Only block when the GPU is still busy with the frame that used this slot
+    // MAX_FRAMES_IN_FLIGHT frames ago.
+    {
+        PROFILE_ZONE("Wait for frame fence");
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    collectFrameStats(currentFrame);
+    destroyRetiredSwapchains();
 
-    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Semaphores this slot waited on last time are free again; then kick off
+    // the meshes uploaded since last frame.
+    uploader.recycleSemaphores(uploadWaitSemaphores[currentFrame]);
+    uploader.flush();
+    readCullResults();
+    releaseRetiredMeshes(false);
+    defragmentIfFragmented();
+
+    // While minimised there is nothing to present; uploads above keep streaming.
+    if (framebufferResized) {
+        recreateSwapchain();
+        if (framebufferResized) return;
+    }
+
+    // Headless frames own the offscreen image of their slot outright.
+    uint32_t imageIndex = (uint32_t)currentFrame;
+    VkResult acquired = headlessMode ? VK_SUCCESS :
+        vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
+                              VK_NULL_HANDLE, &imageIndex);
+    if (acquired == VK_ERROR_OUT_OF_DATE_KHR) {
+        framebufferResized = true;
+        return;
+    }
+    if (acquired != VK_SUCCESS && acquired != VK_SUBOPTIMAL_KHR)
+        throw std::runtime_error("Failed to acquire swapchain image");
+
+    // The swapchain may hand back an image that an older frame is still rendering to.
+    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+        vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+    imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+
+    VkCommandBuffer cb = commandBuffers[currentFrame];
+    vkResetCommandBuffer(cb, 0);
+    recordCommandBuffer(cb, imageIndex);
+
+    std::vector<VkSemaphore> waitSems;
+    std::vector<VkPipelineStageFlags> waitStages;
+    if (!headlessMode) {
+        waitSems.push_back(imageAvailableSemaphores[currentFrame]);
+        waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+    for (auto sem : uploadWaitSemaphores[currentFrame]) {
+        waitSems.push_back(sem);
+        waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
     VkSubmitInfo si{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
-    si.waitSemaphoreCount = 1;
-    si.pWaitSemaphores = &imageAvailableSemaphore;
-    si.pWaitDstStageMask = &waitStage;
+    si.waitSemaphoreCount = (uint32_t)waitSems.size();
+    si.pWaitSemaphores = waitSems.data();
+    si.pWaitDstStageMask = waitStages.data();
     si.commandBufferCount = 1;
-    si.pCommandBuffers = &commandBuffers[imageIndex];
-    si.signalSemaphoreCount = 1;
-    si.pSignalSemaphores = &renderFinishedSemaphore;
-    if (vkQueueSubmit(graphicsQueue, 1, &si, VK_NULL_HANDLE) != VK_SUCCESS)
+    si.pCommandBuffers = &cb;
+    si.signalSemaphoreCount = headlessMode ? 0 : 1;
+    si.pSignalSemaphores = &renderFinishedSemaphores[imageIndex];
+    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    if (vkQueueSubmit(graphicsQueue, 1, &si, inFlightFences[currentFrame]) != VK_SUCCESS)
         throw std::runtime_error("Failed to submit draw command buffer");
 
+    FrameStats& stats = pendingFrameStats[currentFrame];
+    stats = FrameStats{};
+    stats.frame = frameNumber++;
+    stats.drawCalls = frameDrawCalls;
+    stats.triangles = frameTriangles;
+    if (headlessMode) {
+        stats.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        frameTime.observe(stats.cpuMs);
+        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        return;
+    }
+
     VkPresentInfoKHR pi{ VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
     pi.waitSemaphoreCount = 1;
-    pi.pWaitSemaphores = &renderFinishedSemaphore;
+    pi.pWaitSemaphores = &renderFinishedSemaphores[imageIndex];
     pi.swapchainCount = 1;
     pi.pSwapchains = &swapchain;
     pi.pImageIndices = &imageIndex;
-    vkQueuePresentKHR(presentQueue, &pi);
-    vkQueueWaitIdle(presentQueue);
+    VkResult presented = vkQueuePresentKHR(presentQueue, &pi);
+    if (presented == VK_ERROR_OUT_OF_DATE_KHR || presented == VK_SUBOPTIMAL_KHR)
+        framebufferResized = true;
+    else if (presented != VK_SUCCESS)
+        throw std::runtime_error("Failed to present swapchain image");
+    stats.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    frameTime.observe(stats.cpuMs);
+
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 // Helper: create buffer
@@ -474,96 +2039,183 @@ void VulkanApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
     vkGetBufferMemoryRequirements(device, buffer, &memReq);
     VkMemoryAllocateInfo mai{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
     mai.allocationSize = memReq.size;
-    VkPhysicalDeviceMemoryProperties memProps;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
-    uint32_t type = 0;
-    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-        if ((memReq.memoryTypeBits & (1 << i)) &&
-            (memProps.memoryTypes[i].propertyFlags & properties) == properties) {
-            type = i; break;
-        }
-    }
-    mai.memoryTypeIndex = type;
+    mai.memoryTypeIndex = findMemoryType(physicalDevice, memReq.memoryTypeBits, properties);
     if (vkAllocateMemory(device, &mai, nullptr, &bufferMemory) != VK_SUCCESS)
         throw std::runtime_error("Failed to allocate buffer memory");
     vkBindBufferMemory(device, buffer, bufferMemory, 0);
 }
 
-// Helper: copy buffer using a temporary command buffer
-void VulkanApp::copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) {
-    VkCommandBufferAllocateInfo ai{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-    ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    ai.commandPool = commandPool;
-    ai.commandBufferCount = 1;
-    VkCommandBuffer cb;
-    vkAllocateCommandBuffers(device, &ai, &cb);
-    VkCommandBufferBeginInfo bi{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(cb, &bi);
-    VkBufferCopy copy{ 0,0,size };
-    vkCmdCopyBuffer(cb, src, dst, 1, &copy);
-    vkEndCommandBuffer(cb);
-    VkSubmitInfo si{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
-    si.commandBufferCount = 1; si.pCommandBuffers = &cb;
-    vkQueueSubmit(graphicsQueue, 1, &si, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-    vkFreeCommandBuffers(device, commandPool, 1, &cb);
+// 15. Window and event loop
+void VulkanApp::setHeadless(uint32_t width, uint32_t height) {
+    headlessMode = true;
+    headlessExtent = { width, height };
 }
 
-// 15. Window and event loop
 void VulkanApp::initWindow(int width, int height, const char* title) {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    windowTitle = title;
     window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+    glfwSetWindowUserPointer(window, this);
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int, int) {
+        static_cast<VulkanApp*>(glfwGetWindowUserPointer(w))->framebufferResized = true;
+    });
+    glfwSetKeyCallback(window, [](GLFWwindow* w, int key, int, int action, int) {
+        if (key == GLFW_KEY_F11 && action == GLFW_PRESS)
+            static_cast<VulkanApp*>(glfwGetWindowUserPointer(w))->toggleFullscreen();
+    });
 }
 
-void VulkanApp::initVulkan(const std::vector<Vertex>& vertices,
-                           const std::vector<uint32_t>& indices) {
-    createInstance();
-    createSurface();
-    pickPhysicalDevice();
-    createLogicalDevice();
-    createSwapchain();
-    createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
-    createFramebuffers();
-    createCommandPool();
-    uploadMesh(vertices, indices);
-    createCommandBuffers();
-    createSyncObjects();
+// Every step is timed so cold (no pipeline cache) and warm starts can be compared.
+void VulkanApp::initVulkan() {
+    using Clock = std::chrono::steady_clock;
+    initTimings.clear();
+    auto step = [this](const char* name, void (VulkanApp::*fn)()) {
+        auto start = Clock::now();
+        (this->*fn)();
+        initTimings.push_back({ name, std::chrono::duration<double, std::milli>(Clock::now() - start).count() });
+    };
+    step("createInstance", &VulkanApp::createInstance);
+    step("createSurface", &VulkanApp::createSurface);
+    step("pickPhysicalDevice", &VulkanApp::pickPhysicalDevice);
+    step("createLogicalDevice", &VulkanApp::createLogicalDevice);
+    step("createPipelineCache", &VulkanApp::createPipelineCache);
+    step("createSwapchain", &VulkanApp::createSwapchain);
+    step("createImageViews", &VulkanApp::createImageViews);
+    step("createRenderPass", &VulkanApp::createRenderPass);
+    step("createGraphicsPipeline", &VulkanApp::createGraphicsPipeline);
+    step("createDepthResources", &VulkanApp::createDepthResources);
+    step("createFramebuffers", &VulkanApp::createFramebuffers);
+    step("createCommandPool", &VulkanApp::createCommandPool);
+    step("createMeshPools", &VulkanApp::createMeshPools);
+    step("createWorkerCommandPools", &VulkanApp::createWorkerCommandPools);
+    step("createCommandBuffers", &VulkanApp::createCommandBuffers);
+    step("createSyncObjects", &VulkanApp::createSyncObjects);
+    step("createGpuTimer", &VulkanApp::createGpuTimer);
+    step("createHiZResources", &VulkanApp::createHiZResources);
+    step("createCullingResources", &VulkanApp::createCullingResources);
+    step("createBlockTextures", &VulkanApp::createBlockTextures);
+    step("createCameraResources", &VulkanApp::createCameraResources);
+
+    double total = 0.0;
+    for (auto& t : initTimings) total += t.second;
+    std::cout << "initVulkan took " << total << " ms ("
+              << (pipelineCache.warm() ? "warm" : "cold") << " pipeline cache)\n";
+    for (auto& t : initTimings)
+        std::cout << "  " << t.first << ": " << t.second << " ms\n";
 }
 
 void VulkanApp::mainLoop() {
+    PROFILE_THREAD("Main");
     float last = static_cast<float>(glfwGetTime());
+    // Frame rate shown in the title bar, averaged over about a second.
+    float fpsStart = last;
+    uint32_t fpsFrames = 0;
     while (!glfwWindowShouldClose(window)) {
+        PROFILE_ZONE("Frame");
         float now = static_cast<float>(glfwGetTime());
         float dt = now - last;
         last = now;
-        glfwPollEvents();
-        if (updateCallback) updateCallback(dt);
+        fpsFrames++;
+        if (now - fpsStart >= 1.f) {
+            char title[256];
+            std::snprintf(title, sizeof(title), "%s - %.0f FPS (%.2f ms, GPU %.2f ms)", windowTitle.c_str(),
+                          fpsFrames / (now - fpsStart), 1000.f * (now - fpsStart) / fpsFrames,
+                          latestGpuTimings.totalMs);
+            glfwSetWindowTitle(window, title);
+            fpsStart = now;
+            fpsFrames = 0;
+        }
+        {
+            PROFILE_ZONE("Poll events");
+            glfwPollEvents();
+        }
+        if (updateCallback) {
+            PROFILE_ZONE("Update");
+            updateCallback(dt);
+        }
         drawFrame();
     }
     vkDeviceWaitIdle(device);
 }
 
 void VulkanApp::cleanup() {
-    vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-    vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
-    vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
-    for (auto fb : swapchainFramebuffers) vkDestroyFramebuffer(device, fb, nullptr);
+    for (auto sem : renderFinishedSemaphores) vkDestroySemaphore(device, sem, nullptr);
+    for (auto sem : imageAvailableSemaphores) vkDestroySemaphore(device, sem, nullptr);
+    for (auto fence : inFlightFences) vkDestroyFence(device, fence, nullptr);
+    for (auto& f : cullFrames) {
+        vkDestroyBuffer(device, f.chunkInfoBuffer, nullptr);
+        vkFreeMemory(device, f.chunkInfoMemory, nullptr);
+        vkDestroyBuffer(device, f.drawBuffer, nullptr);
+        vkFreeMemory(device, f.drawMemory, nullptr);
+        vkDestroyBuffer(device, f.countBuffer, nullptr);
+        vkFreeMemory(device, f.countMemory, nullptr);
+        vkDestroyBuffer(device, f.paramsBuffer, nullptr);
+        vkFreeMemory(device, f.paramsMemory, nullptr);
+        vkDestroyBuffer(device, f.resultBuffer, nullptr);
+        vkFreeMemory(device, f.resultMemory, nullptr);
+        vkDestroyBuffer(device, f.statsBuffer, nullptr);
+        vkFreeMemory(device, f.statsMemory, nullptr);
+    }
+    cullFrames.clear();
+    for (size_t i = 0; i < cameraBuffers.size(); i++) {
+        vkDestroyBuffer(device, cameraBuffers[i], nullptr);
+        vkFreeMemory(device, cameraMemory[i], nullptr);
+    }
+    vkDestroyDescriptorPool(device, graphicsDescriptorPool, nullptr);
+    vkDestroySampler(device, blockTextureSampler, nullptr);
+    vkDestroyImageView(device, blockTextureView, nullptr);
+    vkDestroyImage(device, blockTextureImage, nullptr);
+    vkFreeMemory(device, blockTextureMemory, nullptr);
+    vkDestroyBuffer(device, materialBuffer, nullptr);
+    vkFreeMemory(device, materialMemory, nullptr);
+    vkDestroyDescriptorPool(device, cullDescriptorPool, nullptr);
+    vkDestroyPipeline(device, cullPipeline, nullptr);
+    vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+    vkDestroyPipeline(device, hizPipeline, nullptr);
+    vkDestroyPipelineLayout(device, hizPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, hizSetLayout, nullptr);
+    vkDestroySampler(device, hizSampler, nullptr);
+    for (auto& sems : uploadWaitSemaphores) uploader.recycleSemaphores(sems);
+    uploader.destroy();
+    meshes.clear();
+    vertexPool.destroy();
+    indexPool.destroy();
+    destroySwapchainResources();
+    pipelineCache.destroy();
     vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    vkDestroyPipeline(device, depthPrepassPipeline, nullptr);
+    vkDestroyPipeline(device, cutoutPipeline, nullptr);
+    vkDestroyPipeline(device, translucentPipeline, nullptr);
+    for (auto& t : translucentFrames) {
+        vkDestroyBuffer(device, t.buffer, nullptr);
+        vkFreeMemory(device, t.memory, nullptr);
+    }
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, graphicsSetLayout, nullptr);
     vkDestroyRenderPass(device, renderPass, nullptr);
-    for (auto iv : swapchainImageViews) vkDestroyImageView(device, iv, nullptr);
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
+    // Headless runs never enable the WSI extensions, so their commands may
+    // not even be loaded.
+    if (headlessMode) {
+        for (size_t i = 0; i < swapchainImages.size(); i++) {
+            vkDestroyImage(device, swapchainImages[i], nullptr);
+            vkFreeMemory(device, offscreenMemory[i], nullptr);
+        }
+    }
+    else {
+        for (auto& r : retiredSwapchains) vkDestroySwapchainKHR(device, r.first, nullptr);
+        retiredSwapchains.clear();
+        vkDestroySwapchainKHR(device, swapchain, nullptr);
+    }
+    gpuTimer.destroy();
+    for (auto pool : workerCommandPools) vkDestroyCommandPool(device, pool, nullptr);
     vkDestroyCommandPool(device, commandPool, nullptr);
     vkDestroyDevice(device, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (!headlessMode) vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 }
\ No newline at end of file
@@ -9,12 +9,40 @@
 #include <vector>
 #include <array>
 #include <functional>
+#include <atomic>
+#include <utility>
 #include <glm/glm.hpp>
+#include "GpuAllocator.h"
+#include "UploadQueue.h"
+#include "PipelineCache.h"
+#include "GpuTimer.h"
+#include "Metrics.h"
+
+class ThreadPool;
+
+// Chunks rejected by the last frame whose culling results were read back.
+struct ChunkCullStats {
+    uint32_t frustumCulled = 0;
+    uint32_t occluded = 0;
+};
+
+// What one frame cost. GPU totalMs spans the frame's command buffer and is -1
+// when the graphics queue has no timestamp support.
+struct FrameStats {
+    uint64_t frame = 0;      // sequence number, from 0
+    double   cpuMs = 0.0;    // wall time of the frame on the CPU, fence wait included
+    GpuFrameTimings gpu;
+    uint32_t drawCalls = 0;  // draw commands recorded, indirect ones counted once
+    uint64_t triangles = 0;  // drawn; GPU-culled draws only count chunks that passed
+};
 
 struct Vertex {
     glm::vec3 pos;
     glm::vec3 normal;
-    glm::vec2 uv;
+    glm::vec2 uv;       // in blocks; the block texture repeats every 1.0
+    uint32_t  material; // packMaterial(block id, ChunkFace)
+
+    static uint32_t packMaterial(uint32_t block, uint32_t face) { return block << 3 | face; }
 
     static VkVertexInputBindingDescription getBindingDescription() {
         VkVertexInputBindingDescription binding{};
@@ -24,8 +52,8 @@ struct Vertex {
         return binding;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 3> attrs{};
+    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 4> attrs{};
         // position
         attrs[0].binding = 0;
         attrs[0].location = 0;
@@ -41,6 +69,11 @@ struct Vertex {
         attrs[2].location = 2;
         attrs[2].format = VK_FORMAT_R32G32_SFLOAT;
         attrs[2].offset = offsetof(Vertex, uv);
+        // material
+        attrs[3].binding = 0;
+        attrs[3].location = 3;
+        attrs[3].format = VK_FORMAT_R32_UINT;
+        attrs[3].offset = offsetof(Vertex, material);
         return attrs;
     }
 };
@@ -48,64 +81,386 @@ struct Vertex {
 class VulkanApp {
 public:
     void initWindow(int width, int height, const char* title);
-    void initVulkan(const std::vector<Vertex>& vertices,
-                    const std::vector<uint32_t>& indices);
-    void uploadMesh(const std::vector<Vertex>& vertices,
-                    const std::vector<uint32_t>& indices);
+    // Renders into offscreen images instead of a window: no GLFW, no surface
+    // and no swapchain, so it runs on machines without a display (lavapipe
+    // included). Replaces initWindow(); frames are driven by renderFrame().
+    void setHeadless(uint32_t width, uint32_t height);
+    bool headless() const { return headlessMode; }
+    void initVulkan();
+    // Uploads a chunk mesh and returns its index in the draw list. Vertex
+    // positions are relative to `origin`, the chunk's world position. Indices
+    // are grouped by render layer: opaque first, then the last
+    // cutoutIndexCount + translucentIndexCount split between cutout and
+    // translucent quads (6 indices per quad).
+    uint32_t uploadMesh(const std::vector<Vertex>& vertices,
+                        const std::vector<uint32_t>& indices,
+                        const glm::vec3& origin = glm::vec3(0.f),
+                        uint32_t cutoutIndexCount = 0,
+                        uint32_t translucentIndexCount = 0);
+    // Drops a mesh's geometry, e.g. when its chunk unloads. The id stays
+    // valid and draws nothing; its memory is recycled once no frame in
+    // flight can still read it.
+    void freeMesh(uint32_t id);
     void mainLoop();
+    // One frame outside mainLoop(), for headless runs.
+    void renderFrame() { drawFrame(); }
+    // True once every mesh uploaded so far can be drawn.
+    bool uploadsComplete() const { return residentTicket >= uploader.lastTicket(); }
+    // Per-frame statistics are kept only while enabled. A frame's entry
+    // becomes available once its GPU work is done; finishFrames() waits for
+    // all of them.
+    void setFrameStatsEnabled(bool enabled) { frameStatsEnabled = enabled; }
+    std::vector<FrameStats> takeFrameStats();
+    void finishFrames();
+    const std::string& deviceName() const { return gpuName; }
+    // GPU passes of the most recent frame whose queries have been read back.
+    const GpuFrameTimings& gpuTimings() const { return latestGpuTimings; }
     GLFWwindow* getWindow() const { return window; }
+    // Switches between windowed and fullscreen on the primary monitor (also F11).
+    void toggleFullscreen();
     void setUpdateCallback(const std::function<void(float)>& cb) { updateCallback = cb; }
+    // Worker threads used to record secondary command buffers. Must be set
+    // before initVulkan(); without it all draws are recorded on the caller.
+    void setRecordPool(ThreadPool* pool) { recordPool = pool; }
+    // GPU-driven mode: all chunk meshes share one vertex and one index buffer,
+    // a compute pass frustum-culls them and writes indirect draws. Must be set
+    // before initVulkan().
+    void setGpuDriven(bool enabled) { gpuDriven = enabled; }
+    // View matrix for the next frame; the projection follows the swapchain's
+    // aspect ratio. The same camera drives culling: frustum culling only applies
+    // in GPU-driven mode, occlusion culling to both modes.
+    void setCamera(const glm::mat4& view) { cameraView = view; }
+    ChunkCullStats cullStats() const { return lastCullStats; }
+    // CPU visibility, one entry per uploaded mesh. Meshes marked 0 are skipped
+    // before any GPU culling; an empty list draws everything.
+    void setChunkVisibility(const std::vector<uint8_t>& visible);
+    // Mesh memory usage, and compaction of the mesh pools when they fragment.
+    GpuPoolStats vertexMemoryStats() const { return vertexPool.stats(); }
+    GpuPoolStats indexMemoryStats() const { return indexPool.stats(); }
+    void logMeshMemoryStats() const;
+    // Sets the gpu_mesh_memory_* gauges from the mesh pools.
+    void publishMeshMemoryMetrics() const;
+    // Wall time of each initVulkan step in milliseconds, in call order.
+    const std::vector<std::pair<const char*, double>>& startupTimings() const { return initTimings; }
+    // Also run by drawFrame when freed meshes leave a pool fragmented.
+    void defragmentMeshMemory();
     void cleanup();
 
 private:
     GLFWwindow* window = nullptr;
+    std::string windowTitle;
     std::function<void(float)> updateCallback;
+    bool        framebufferResized = false; // swapchain must be rebuilt before the next frame
+    int         windowedPos[2] = { 0, 0 };  // restored when leaving fullscreen
+    int         windowedSize[2] = { 0, 0 };
 
     VkInstance               instance;
     VkPhysicalDevice         physicalDevice = VK_NULL_HANDLE;
+    std::string              gpuName;
     VkDevice                 device;
     VkQueue                  graphicsQueue;
     VkQueue                  presentQueue;
+    VkQueue                  transferQueue;           // graphicsQueue when there is no dedicated family
     uint32_t                 graphicsQueueFamilyIndex = 0;
     uint32_t                 presentQueueFamilyIndex = 0;
+    uint32_t                 transferQueueFamilyIndex = 0;
 
-    VkSurfaceKHR             surface;
-    VkSwapchainKHR           swapchain;
-    VkFormat                 swapchainImageFormat;
+    VkSurfaceKHR             surface = VK_NULL_HANDLE;
+    VkSwapchainKHR           swapchain = VK_NULL_HANDLE;
+    VkFormat                 swapchainImageFormat = VK_FORMAT_UNDEFINED;
     VkExtent2D               swapchainExtent;
     std::vector<VkImage>     swapchainImages;
     std::vector<VkImageView> swapchainImageViews;
+    // Replaced swapchains and the frameNumber of the first frame on their
+    // successor. Fences do not cover presents, so each is destroyed only once
+    // MAX_FRAMES_IN_FLIGHT frames on the new swapchain have completed.
+    std::vector<std::pair<VkSwapchainKHR, uint64_t>> retiredSwapchains;
+
+    // Headless mode: the "swapchain" images are plain device-local images,
+    // one per frame in flight, left in TRANSFER_SRC layout for readback.
+    static constexpr VkFormat     OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+    bool                          headlessMode = false;
+    VkExtent2D                    headlessExtent{ 0, 0 };
+    std::vector<VkDeviceMemory>   offscreenMemory;
+
+    // Frame statistics. Draw counts are summed by every recording thread; GPU
+    // timings come from gpuTimer, one slot per frame in flight, read back once
+    // the frame's fence has signalled.
+    bool                          frameStatsEnabled = false;
+    uint64_t                      frameNumber = 0;
+    std::atomic<uint32_t>         frameDrawCalls{0};
+    std::atomic<uint64_t>         frameTriangles{0};
+    GpuTimer                      gpuTimer;
+    bool                          pipelineStatisticsQuery = false;
+    bool                          inheritedQueries = false; // statistics also count secondaries
+    GpuFrameTimings               latestGpuTimings;
+    // Frame time histogram buckets, 0.25 ms to ~1 s in 25% steps.
+    inline static const std::vector<double> FRAME_TIME_BOUNDS_MS = Histogram::exponentialBounds(0.25, 1.25, 38);
+    std::vector<FrameStats>       pendingFrameStats;  // per frame in flight, frame == UINT64_MAX when empty
+    std::vector<FrameStats>       completedFrameStats;
+
+    // Pipelines are compiled through a cache persisted next to the executable.
+    static constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+    PipelineCache               pipelineCache;
+    std::vector<std::pair<const char*, double>> initTimings;
+
+    // Block textures: one mipmapped 2D array with a layer per BlockRegistry
+    // texture, and a table of block materials (layer per face, tint) indexed by
+    // the block id in each vertex. Both live in the graphics descriptor set, so
+    // the world draws with a single bind and pipeline. Layout matches
+    // Shaders/frag.frag.
+    static constexpr uint32_t BLOCK_TEXTURE_SIZE = 16;
+    struct GpuBlockMaterial {
+        uint32_t faceLayers[6];
+        uint32_t tint;
+        uint32_t pad;
+    };
+    VkImage                  blockTextureImage = VK_NULL_HANDLE;
+    VkDeviceMemory           blockTextureMemory = VK_NULL_HANDLE;
+    VkImageView              blockTextureView = VK_NULL_HANDLE;
+    VkSampler                blockTextureSampler = VK_NULL_HANDLE;
+    VkBuffer                 materialBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory           materialMemory = VK_NULL_HANDLE;
+
+    // Camera uniforms, one buffer per frame in flight. The graphics descriptor
+    // set also exposes that frame's chunk table, where indirect draws look up
+    // their chunk origin; direct draws push it as a constant instead.
+    static constexpr float CAMERA_FOV_Y = 70.f; // degrees
+    static constexpr float CAMERA_NEAR = 0.1f;
+    static constexpr float CAMERA_FAR = 1000.f;
+    struct CameraUniforms {
+        glm::mat4 view;
+        glm::mat4 proj;
+        glm::mat4 viewProj;
+    };
+    glm::mat4                    cameraView{1.f};
+    std::vector<VkBuffer>        cameraBuffers;
+    std::vector<VkDeviceMemory>  cameraMemory;
+    std::vector<CameraUniforms*> cameraUniforms;
+    VkDescriptorSetLayout        graphicsSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool             graphicsDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> graphicsDescriptorSets;
 
     VkRenderPass                renderPass;
     VkPipelineLayout            pipelineLayout;
-    VkPipeline                  graphicsPipeline;
+    VkPipeline                  graphicsPipeline;     // depth test only, after the pre-pass
+    VkPipeline                  depthPrepassPipeline; // depth writes, no colour
     std::vector<VkFramebuffer>  swapchainFramebuffers;
 
+    // Depth buffer, sampled after the render pass to build the Hi-Z pyramid.
+    VkFormat                    depthFormat = VK_FORMAT_UNDEFINED;
+    VkImage                     depthImage = VK_NULL_HANDLE;
+    VkDeviceMemory              depthMemory = VK_NULL_HANDLE;
+    VkImageView                 depthView = VK_NULL_HANDLE;
+
+    // Hi-Z pyramid: level 0 is half the depth buffer, each texel the farthest
+    // depth beneath it. Built at the end of every frame and tested against by
+    // the next frame's culling pass.
+    VkImage                      hizImage = VK_NULL_HANDLE;
+    VkDeviceMemory               hizMemory = VK_NULL_HANDLE;
+    VkImageView                  hizView = VK_NULL_HANDLE;   // all levels, for culling
+    std::vector<VkImageView>     hizMipViews;                // one per level, for building
+    VkSampler                    hizSampler = VK_NULL_HANDLE;
+    VkExtent2D                   hizExtent{};
+    uint32_t                     hizLevels = 0;
+    bool                         hizValid = false;           // a previous frame has filled it
+    glm::mat4                    hizViewProj{1.f};           // camera it was rendered with
+    VkDescriptorSetLayout        hizSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool             hizDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> hizDescriptorSets;          // one per level
+    VkPipelineLayout             hizPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline                   hizPipeline = VK_NULL_HANDLE;
+
+    // Frames in flight: the CPU records frame N+1 while the GPU renders frame N.
+    static constexpr size_t MAX_FRAMES_IN_FLIGHT = 2;
+
     VkCommandPool               commandPool;
-    std::vector<VkCommandBuffer> commandBuffers;
-    VkSemaphore                 imageAvailableSemaphore;
-    VkSemaphore                 renderFinishedSemaphore;
+    std::vector<VkCommandBuffer> commandBuffers;          // one per frame in flight
+    std::vector<VkSemaphore>    imageAvailableSemaphores; // one per frame in flight
+    std::vector<VkSemaphore>    renderFinishedSemaphores; // one per swapchain image
+    std::vector<VkFence>        inFlightFences;           // one per frame in flight
+    std::vector<VkFence>        imagesInFlight;           // fence owning each swapchain image
+    std::vector<std::vector<VkSemaphore>> uploadWaitSemaphores; // per frame in flight
+    size_t                      currentFrame = 0;
+
+    // Parallel recording: one command pool per (frame in flight, worker slice),
+    // indexed frame * recordThreads + slice, holding a depth pre-pass, a colour
+    // and a cutout/translucent secondary buffer from
+    // SECONDARIES_PER_SLICE * index. Only the last slice records the third.
+    static constexpr size_t MIN_DRAWS_PER_RECORD_THREAD = 64;
+    static constexpr size_t SECONDARIES_PER_SLICE = 3;
+    ThreadPool*                  recordPool = nullptr;
+    size_t                       recordThreads = 0;
+    std::vector<VkCommandPool>   workerCommandPools;
+    std::vector<VkCommandBuffer> secondaryCommandBuffers;
 
-    // Test‐triangle buffers
-    VkBuffer       vertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
-    VkBuffer       indexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
-    uint32_t       indexCount = 0;
+    // Chunk meshes, sub-allocated from a few large device-local blocks.
+    static constexpr VkDeviceSize MESH_VERTEX_BLOCK_SIZE = 64ull << 20;
+    static constexpr VkDeviceSize MESH_INDEX_BLOCK_SIZE = 32ull << 20;
+    struct GpuMesh {
+        GpuAllocation vertexAlloc;
+        GpuAllocation indexAlloc;
+        uint32_t      indexCount = 0;       // opaque indices, at the start of indexAlloc
+        uint32_t      cutoutIndexCount = 0; // right after the opaque ones
+        uint64_t      uploadTicket = 0; // drawable once residentTicket reaches it
+        glm::vec3     origin{0.f};    // world position of the mesh's local origin
+        glm::vec3     boundsMin{0.f}; // world space
+        glm::vec3     boundsMax{0.f};
+        std::vector<uint32_t>  translucentIndices; // CPU only, 6 per quad
+        std::vector<glm::vec3> translucentCenters; // world-space centre of each quad
+        uint32_t      translucentFirst = 0;  // into sortedTranslucent
+    };
+    GpuBufferPool        vertexPool;
+    GpuBufferPool        indexPool;
+    std::vector<GpuMesh> meshes;
+
+    // Ranges of freed meshes wait here until the frames that may draw them,
+    // and the upload that fills them, have completed. Once a pool's
+    // fragmentation passes DEFRAGMENT_THRESHOLD after a free, drawFrame
+    // compacts the pools.
+    static constexpr float DEFRAGMENT_THRESHOLD = 0.5f;
+    struct RetiredMesh {
+        GpuAllocation vertexAlloc;
+        GpuAllocation indexAlloc;
+        uint64_t      uploadTicket = 0;
+        uint64_t      frame = 0; // frameNumber when freed
+    };
+    std::vector<RetiredMesh> retiredMeshes;
+    bool                     meshMemoryFreed = false; // since the last defragmentation check
+
+    // Blended geometry. Translucent quads stay on the CPU and are sorted back
+    // to front, per chunk and chunk by chunk, whenever the camera has moved
+    // TRANSLUCENT_RESORT_DISTANCE since the last sort. Each frame in flight
+    // copies the sorted list into its own host-visible index buffer when it
+    // is out of date, so a re-sort never touches indices the GPU is reading.
+    static constexpr float TRANSLUCENT_RESORT_DISTANCE = 1.f;
+    struct TranslucentFrame {
+        VkBuffer       buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        uint32_t*      indices = nullptr;
+        size_t         capacity = 0; // in indices
+        uint64_t       version = 0;  // translucentVersion last copied
+    };
+    VkPipeline              cutoutPipeline = VK_NULL_HANDLE;
+    VkPipeline              translucentPipeline = VK_NULL_HANDLE;
+    std::array<TranslucentFrame, MAX_FRAMES_IN_FLIGHT> translucentFrames;
+    std::vector<uint32_t>   sortedTranslucent;
+    std::vector<uint32_t>   translucentOrder;   // mesh ids, far to near
+    uint64_t                translucentVersion = 0;
+    bool                    translucentDirty = false; // a mesh added quads since the last sort
+    glm::vec3               lastSortPosition{0.f};
+
+    // Mesh uploads queued by uploadMesh are submitted once per frame, on the
+    // dedicated transfer queue when the device has one.
+    static constexpr VkDeviceSize STAGING_RING_SIZE = 32ull << 20;
+    UploadQueue                  uploader;
+    uint64_t                     residentTicket = 0;
+
+    // Chunk culling. Each frame a compute pass tests every chunk against the
+    // frustum and the Hi-Z pyramid; results are read back once the frame's
+    // fence signals. In GPU-driven mode it also writes the indirect draws, and
+    // the mesh pools are limited to a single block each so that every draw
+    // comes from one pair of buffers. Layouts match Shaders/cull.comp.
+    static constexpr VkDeviceSize GPU_DRIVEN_VERTEX_BUFFER_SIZE = 256ull << 20;
+    static constexpr VkDeviceSize GPU_DRIVEN_INDEX_BUFFER_SIZE = 128ull << 20;
+    static constexpr uint32_t     MAX_GPU_CHUNKS = 65536;
+    struct ChunkDrawInfo {
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+        glm::vec4 origin;
+        uint32_t  indexCount;
+        uint32_t  firstIndex;
+        int32_t   vertexOffset;
+        uint32_t  pad;
+    };
+    struct CullParams {
+        glm::mat4 prevViewProj;
+        glm::vec4 planes[6];
+        glm::vec2 hizSize;
+        uint32_t  hizLevels;
+        uint32_t  chunkCount;
+        uint32_t  compact;
+    };
+    enum CullResult : uint32_t { CULL_VISIBLE = 0, CULL_FRUSTUM = 1, CULL_OCCLUDED = 2 };
+    struct CullFrame {                  // one per frame in flight
+        VkBuffer        chunkInfoBuffer = VK_NULL_HANDLE;  // host-visible, persistently mapped
+        VkDeviceMemory  chunkInfoMemory = VK_NULL_HANDLE;
+        ChunkDrawInfo*  chunkInfos = nullptr;
+        uint64_t        chunkInfoVersion = 0;              // drawListVersion last written
+        VkBuffer        drawBuffer = VK_NULL_HANDLE;       // VkDrawIndexedIndirectCommand[]
+        VkDeviceMemory  drawMemory = VK_NULL_HANDLE;
+        VkBuffer        countBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory  countMemory = VK_NULL_HANDLE;
+        VkBuffer        paramsBuffer = VK_NULL_HANDLE;     // host-visible CullParams
+        VkDeviceMemory  paramsMemory = VK_NULL_HANDLE;
+        CullParams*     params = nullptr;
+        VkBuffer        resultBuffer = VK_NULL_HANDLE;     // host-visible CullResult per chunk
+        VkDeviceMemory  resultMemory = VK_NULL_HANDLE;
+        uint32_t*       results = nullptr;
+        VkBuffer        statsBuffer = VK_NULL_HANDLE;      // host-visible ChunkCullStats
+        VkDeviceMemory  statsMemory = VK_NULL_HANDLE;
+        ChunkCullStats* stats = nullptr;
+        uint32_t        culledChunks = 0;                  // chunks covered by results, 0 once read
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+    bool                    gpuDriven = false;
+    bool                    multiDrawIndirect = false;
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+    glm::mat4               cullViewProj{1.f};
+    uint64_t                drawListVersion = 1; // bumped whenever a ChunkDrawInfo changes
+    VkDescriptorSetLayout   cullSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool        cullDescriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout        cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline              cullPipeline = VK_NULL_HANDLE;
+    std::vector<CullFrame>  cullFrames;
+    std::vector<uint8_t>    chunkOccluded;  // CPU draw path: skipped until visible again
+    std::vector<uint8_t>    chunkVisible;   // from setChunkVisibility
+    ChunkCullStats          lastCullStats;
 
     // Setup steps
     void createInstance();
     void createSurface();
     void pickPhysicalDevice();
     void createLogicalDevice();
+    void createPipelineCache();
     void createSwapchain();
+    void createOffscreenTargets();
+    void recreateSwapchain();
+    void destroySwapchainResources();
     void createImageViews();
     void createRenderPass();
     void createGraphicsPipeline();
+    void createDepthResources();
     void createFramebuffers();
     void createCommandPool();
+    void createMeshPools();
     void createCommandBuffers();
+    void createWorkerCommandPools();
     void createSyncObjects();
+    void createGpuTimer();
+    void collectFrameStats(size_t frame);
+    void createHiZResources();
+    void createHiZImages();
+    void destroyHiZImages();
+    void createCullingResources();
+    void createBlockTextures();
+    void createCameraResources();
+    void recordCulling(VkCommandBuffer cb);
+    void recordHiZ(VkCommandBuffer cb);
+    void readCullResults();
+    void recordIndirectDraws(VkCommandBuffer cb);
+    void setViewportAndScissor(VkCommandBuffer cb);
+    void recordCommandBuffer(VkCommandBuffer cb, uint32_t imageIndex);
+    void recordDraws(VkCommandBuffer cb, VkPipeline pipeline, size_t first, size_t last);
+    void sortTranslucent(const glm::vec3& eye);
+    void updateTranslucentIndices();
+    bool layerDrawable(size_t mesh) const;
+    void releaseRetiredMeshes(bool all);
+    void destroyRetiredSwapchains();
+    void defragmentIfFragmented();
+    void recordLayerDraws(VkCommandBuffer cb);
+    std::array<VkCommandBuffer, SECONDARIES_PER_SLICE> recordSecondary(size_t slice, size_t first,
+                                                                       size_t last, uint32_t imageIndex);
     void drawFrame();
 
     // GPU buffer helpers
@@ -115,10 +470,6 @@ private:
         VkBuffer& buffer,
         VkDeviceMemory& bufferMemory);
 
-    void copyBuffer(VkBuffer src,
-        VkBuffer dst,
-        VkDeviceSize size);
-
     // Shader loader helpers
     static std::vector<char> readFile(const std::string& filename);
     static VkShaderModule     createShaderModule(VkDevice device, const std::vector<char>& code);
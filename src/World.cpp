@@ -0,0 +1,99 @@
+#include "World.h"
+#include <memory>
+
+uint64_t World::key(const glm::ivec3& p) {
+    return (uint64_t(uint32_t(p.x) & 0x1FFFFF) << 42) |
+           (uint64_t(uint32_t(p.y) & 0x1FFFFF) << 21) |
+            uint64_t(uint32_t(p.z) & 0x1FFFFF);
+}
+
+void World::insert(ChunkHandle handle) {
+    if (Chunk* chunk = pool.get(handle)) chunks[key(chunk->position)] = handle;
+}
+
+Chunk* World::find(const glm::ivec3& chunkPosition) const {
+    auto it = chunks.find(key(chunkPosition));
+    return it == chunks.end() ? nullptr : pool.get(it->second);
+}
+
+// Floor division, so voxel -1 belongs to chunk -1.
+glm::ivec3 World::chunkOf(const glm::ivec3& voxel) {
+    const glm::ivec3 d = Chunk::dims();
+    glm::ivec3 c;
+    for (int a = 0; a < 3; ++a)
+        c[a] = voxel[a] >= 0 ? voxel[a] / d[a] : (voxel[a] + 1) / d[a] - 1;
+    return c;
+}
+
+template <class Op>
+void World::forEachChunk(const glm::ivec3& lo, const glm::ivec3& hi, Op op) const {
+    if (lo.x >= hi.x || lo.y >= hi.y || lo.z >= hi.z) return;
+    const glm::ivec3 first = chunkOf(lo), last = chunkOf(hi - glm::ivec3(1));
+    for (int z = first.z; z <= last.z; ++z)
+        for (int y = first.y; y <= last.y; ++y)
+            for (int x = first.x; x <= last.x; ++x) {
+                Chunk* chunk = find({ x, y, z });
+                if (!chunk) continue;
+                const glm::ivec3 o = origin(chunk->position);
+                op(*chunk, lo - o, hi - o);
+            }
+}
+
+void World::fillBox(const glm::ivec3& lo, const glm::ivec3& hi, Voxel v, std::vector<glm::ivec3>* changed) {
+    forEachChunk(lo, hi, [&](Chunk& chunk, const glm::ivec3& l, const glm::ivec3& h) {
+        chunk.fillBox(l, h, v);
+        if (changed) changed->push_back(chunk.position);
+    });
+}
+
+void World::fillSphere(const glm::vec3& centre, float radius, Voxel v, std::vector<glm::ivec3>* changed) {
+    if (radius <= 0.f) return;
+    const glm::ivec3 lo(glm::floor(centre - glm::vec3(radius))), hi(glm::ceil(centre + glm::vec3(radius)));
+    forEachChunk(lo, hi, [&](Chunk& chunk, const glm::ivec3&, const glm::ivec3&) {
+        chunk.fillSphere(centre - glm::vec3(origin(chunk.position)), radius, v);
+        if (changed) changed->push_back(chunk.position);
+    });
+}
+
+void World::replace(const glm::ivec3& lo, const glm::ivec3& hi, Voxel from, Voxel to,
+                    std::vector<glm::ivec3>* changed) {
+    forEachChunk(lo, hi, [&](Chunk& chunk, const glm::ivec3& l, const glm::ivec3& h) {
+        if (chunk.count(l, h, from) == 0) return;
+        chunk.replace(l, h, from, to);
+        if (changed) changed->push_back(chunk.position);
+    });
+}
+
+size_t World::count(const glm::ivec3& lo, const glm::ivec3& hi, Voxel type) const {
+    size_t total = 0;
+    forEachChunk(lo, hi, [&](Chunk& chunk, const glm::ivec3& l, const glm::ivec3& h) {
+        total += chunk.count(l, h, type);
+    });
+    return total;
+}
+
+// The source chunks are snapshotted first, so an overlapping destination
+// never reads voxels this copy already wrote. Each destination chunk then
+// takes one Chunk::copyRegion per source chunk its part of the box maps onto.
+void World::copyRegion(const glm::ivec3& lo, const glm::ivec3& hi, const glm::ivec3& dstLo,
+                       std::vector<glm::ivec3>* changed) {
+    std::vector<std::unique_ptr<Chunk>> sources;
+    forEachChunk(lo, hi, [&](Chunk& chunk, const glm::ivec3&, const glm::ivec3&) {
+        sources.push_back(std::make_unique<Chunk>(chunk));
+    });
+    if (sources.empty()) return;
+
+    const glm::ivec3 offset = dstLo - lo;
+    forEachChunk(dstLo, hi + offset, [&](Chunk& chunk, const glm::ivec3& l, const glm::ivec3& h) {
+        // This chunk's share of the destination box, in world coordinates.
+        const glm::ivec3 o = origin(chunk.position);
+        const glm::ivec3 dLo = glm::max(l, glm::ivec3(0)) + o, dHi = glm::min(h, Chunk::dims()) + o;
+        for (const auto& source : sources) {
+            const glm::ivec3 so = origin(source->position);
+            const glm::ivec3 sLo = glm::max(dLo - offset, so), sHi = glm::min(dHi - offset, so + Chunk::dims());
+            if (sLo.x >= sHi.x || sLo.y >= sHi.y || sLo.z >= sHi.z) continue;
+            chunk.copyRegion(*source, sLo - so, sLo + offset - o, sHi - sLo);
+        }
+        if (changed) changed->push_back(chunk.position);
+    });
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "Chunk.h"
+#include "ChunkPool.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// The loaded chunks by position, over a ChunkPool that owns them. Inserting
+// and removing is for the thread that loads the world; lookups and edits may
+// run from any thread while the set of chunks stays the same, as long as two
+// edits never touch the same chunk at once.
+//
+// The bulk edits take world voxel coordinates and boxes [lo, hi). They hand
+// each loaded chunk the part of the edit that falls inside it (see Chunk's
+// bulk operations), skip chunks that aren't loaded, and append the positions
+// of the chunks they changed to `changed` when given, for remeshing.
+class World {
+public:
+    explicit World(ChunkPool& pool) : pool(pool) {}
+
+    // Registers a chunk from the pool at its chunk.position.
+    void insert(ChunkHandle handle);
+    // Forgets every chunk; releasing them is up to the caller.
+    void clear() { chunks.clear(); }
+    Chunk* find(const glm::ivec3& chunkPosition) const;
+    size_t size() const { return chunks.size(); }
+
+    // The chunk holding a voxel, and the voxel's first corner in world space.
+    static glm::ivec3 chunkOf(const glm::ivec3& voxel);
+    static glm::ivec3 origin(const glm::ivec3& chunkPosition) { return chunkPosition * Chunk::dims(); }
+    // A chunk position packed into one integer, for hashing.
+    static uint64_t key(const glm::ivec3& chunkPosition);
+
+    void fillBox(const glm::ivec3& lo, const glm::ivec3& hi, Voxel v, std::vector<glm::ivec3>* changed = nullptr);
+    void fillSphere(const glm::vec3& centre, float radius, Voxel v, std::vector<glm::ivec3>* changed = nullptr);
+    void replace(const glm::ivec3& lo, const glm::ivec3& hi, Voxel from, Voxel to,
+                 std::vector<glm::ivec3>* changed = nullptr);
+    size_t count(const glm::ivec3& lo, const glm::ivec3& hi, Voxel type) const;
+    // Copies the box [lo, hi) so that lo lands on dstLo. The boxes may overlap.
+    void copyRegion(const glm::ivec3& lo, const glm::ivec3& hi, const glm::ivec3& dstLo,
+                    std::vector<glm::ivec3>* changed = nullptr);
+
+private:
+    ChunkPool&                              pool;
+    std::unordered_map<uint64_t, ChunkHandle> chunks; // packed position -> handle
+
+    // Calls op(chunk, localLo, localHi) for every loaded chunk the box overlaps.
+    template <class Op>
+    void forEachChunk(const glm::ivec3& lo, const glm::ivec3& hi, Op op) const;
+};
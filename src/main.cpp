@@ -2,11 +2,30 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 
-int main() {
+int main(int argc, char** argv) {
     PixelGame game;
+    BenchmarkOptions bench;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--gpu-driven") == 0) game.setGpuDriven(true);
+        if (std::strcmp(argv[i], "--cave-culling") == 0) game.setCaveCulling(true);
+        if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) game.setTracePath(argv[++i]);
+        if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) game.setMetricsPath(argv[++i]);
+        // Headless run along a scripted camera path, e.g. --benchmark out.json --frames 600.
+        if (std::strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) bench.reportPath = argv[++i];
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            bench.frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        if (std::strcmp(argv[i], "--resolution") == 0 && i + 1 < argc &&
+            std::sscanf(argv[++i], "%ux%u", &bench.width, &bench.height) != 2) {
+            std::cerr << "ERROR: --resolution expects WxH" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
     try {
-        game.run();
+        if (!bench.reportPath.empty()) game.runBenchmark(bench);
+        else game.run();
     }
     catch (const std::runtime_error& e) {
         std::cerr << "ERROR: " << e.what() << std::endl;